@@ -0,0 +1,148 @@
+#include "../Lib/include/acpi.h"
+
+// Just enough ACPI to find the interrupt controllers: RSDP -> RSDT ->
+// MADT. Tables are read in place (everything is identity-mapped).
+
+typedef struct {
+    char signature[8];                 // "RSD PTR "
+    unsigned char checksum;
+    char oem_id[6];
+    unsigned char revision;
+    unsigned int rsdt_address;
+} __attribute__((packed)) rsdp_t;
+
+typedef struct {
+    char signature[4];
+    unsigned int length;
+    unsigned char revision;
+    unsigned char checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    unsigned int oem_revision;
+    unsigned int creator_id;
+    unsigned int creator_revision;
+} __attribute__((packed)) sdt_header_t;
+
+// MADT entry types
+#define MADT_LAPIC          0
+#define MADT_IOAPIC         1
+#define MADT_OVERRIDE       2
+#define MADT_LAPIC_ADDRESS  5
+
+static acpi_madt_t madt;
+static int madt_found = 0;
+
+// Bytes of a valid table sum to zero
+static int checksum_ok(const void* data, unsigned int length) {
+    const unsigned char* bytes = data;
+    unsigned char sum = 0;
+    for (unsigned int i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+    return sum == 0;
+}
+
+static int signature_is(const char* sig, const char* expected, int length) {
+    for (int i = 0; i < length; i++) {
+        if (sig[i] != expected[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Look for the RSDP on 16-byte boundaries in [start, end)
+static const rsdp_t* rsdp_scan(unsigned int start, unsigned int end) {
+    for (unsigned int addr = start; addr < end; addr += 16) {
+        const rsdp_t* rsdp = (const rsdp_t*)addr;
+        if (signature_is(rsdp->signature, "RSD PTR ", 8) && checksum_ok(rsdp, sizeof(rsdp_t))) {
+            return rsdp;
+        }
+    }
+    return 0;
+}
+
+// The RSDP is in the first KB of the EBDA or in the BIOS ROM
+static const rsdp_t* rsdp_find() {
+    unsigned int ebda = (unsigned int)*(const unsigned short*)0x40E << 4;
+    const rsdp_t* rsdp = 0;
+    
+    if (ebda >= 0x80000 && ebda < 0xA0000) {
+        rsdp = rsdp_scan(ebda, ebda + 1024);
+    }
+    if (!rsdp) {
+        rsdp = rsdp_scan(0xE0000, 0x100000);
+    }
+    return rsdp;
+}
+
+static void madt_parse(const sdt_header_t* header) {
+    const unsigned char* entry = (const unsigned char*)header + sizeof(sdt_header_t) + 8;
+    const unsigned char* end = (const unsigned char*)header + header->length;
+    
+    madt.lapic_address = *(const unsigned int*)((const unsigned char*)header + sizeof(sdt_header_t));
+    madt.pcat_compat = *(const unsigned int*)((const unsigned char*)header + sizeof(sdt_header_t) + 4) & 1;
+    for (int i = 0; i < ACPI_ISA_IRQS; i++) {
+        madt.isa_gsi[i] = i;
+        madt.isa_flags[i] = 0;
+    }
+    
+    while (entry + 2 <= end && entry[1] >= 2 && entry + entry[1] <= end) {
+        if (entry[0] == MADT_LAPIC) {
+            // Processor UID, APIC ID, flags (bit 0: enabled)
+            if ((*(const unsigned int*)(entry + 4) & 1) && madt.cpu_count < ACPI_MAX_CPUS) {
+                madt.cpu_apic_ids[madt.cpu_count++] = entry[3];
+            }
+        } else if (entry[0] == MADT_IOAPIC) {
+            if (madt.ioapic_count < ACPI_MAX_IOAPICS) {
+                acpi_ioapic_t* ioapic = &madt.ioapics[madt.ioapic_count++];
+                ioapic->id = entry[2];
+                ioapic->address = *(const unsigned int*)(entry + 4);
+                ioapic->gsi_base = *(const unsigned int*)(entry + 8);
+            }
+        } else if (entry[0] == MADT_OVERRIDE) {
+            // Bus 0 (ISA), source IRQ, GSI, flags
+            if (entry[2] == 0 && entry[3] < ACPI_ISA_IRQS) {
+                madt.isa_gsi[entry[3]] = *(const unsigned int*)(entry + 4);
+                madt.isa_flags[entry[3]] = *(const unsigned short*)(entry + 8);
+            }
+        } else if (entry[0] == MADT_LAPIC_ADDRESS) {
+            // 64-bit override; only usable below 4 GB
+            unsigned long long address = *(const unsigned long long*)(entry + 4);
+            if (address < 0x100000000ULL) {
+                madt.lapic_address = (unsigned int)address;
+            }
+        }
+        entry += entry[1];
+    }
+}
+
+// Find and parse the MADT (returns 0 if there is none)
+int acpi_init() {
+    const rsdp_t* rsdp = rsdp_find();
+    if (!rsdp) {
+        return 0;
+    }
+    
+    const sdt_header_t* rsdt = (const sdt_header_t*)rsdp->rsdt_address;
+    if (!signature_is(rsdt->signature, "RSDT", 4) || !checksum_ok(rsdt, rsdt->length)) {
+        return 0;
+    }
+    
+    const unsigned int* tables = (const unsigned int*)(rsdt + 1);
+    unsigned int count = (rsdt->length - sizeof(sdt_header_t)) / 4;
+    for (unsigned int i = 0; i < count; i++) {
+        const sdt_header_t* header = (const sdt_header_t*)tables[i];
+        if (signature_is(header->signature, "APIC", 4) && checksum_ok(header, header->length)) {
+            madt_parse(header);
+            madt_found = 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Parsed MADT (0 if acpi_init() found none)
+const acpi_madt_t* acpi_madt() {
+    return madt_found ? &madt : 0;
+}
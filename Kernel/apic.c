@@ -0,0 +1,282 @@
+#include "../Lib/include/apic.h"
+#include "../Lib/include/acpi.h"
+#include "../Lib/include/cpu.h"
+#include "../Lib/include/idt.h"
+#include "../Lib/include/paging.h"
+#include "../Lib/include/timer.h"
+
+// Local APIC registers (byte offsets from the LAPIC base)
+#define LAPIC_ID            0x020
+#define LAPIC_TPR           0x080
+#define LAPIC_EOI           0x0B0
+#define LAPIC_SVR           0x0F0
+#define LAPIC_ICR_LOW       0x300
+#define LAPIC_ICR_HIGH      0x310
+#define LAPIC_LVT_TIMER     0x320
+#define LAPIC_LVT_LINT0     0x350
+#define LAPIC_LVT_ERROR     0x370
+#define LAPIC_TIMER_INITIAL 0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE  0x3E0
+
+#define LAPIC_ENABLE        (1 << 8)   // SVR
+#define LVT_MASKED          (1 << 16)
+#define LVT_PERIODIC        (1 << 17)
+
+// Interrupt command register
+#define ICR_INIT            (5 << 8)
+#define ICR_STARTUP         (6 << 8)
+#define ICR_PENDING         (1 << 12)
+#define ICR_ASSERT          (1 << 14)
+#define ICR_LEVEL           (1 << 15)
+#define ICR_ALL_BUT_SELF    (3 << 18)
+
+#define MSR_APIC_BASE       0x1B
+#define APIC_BASE_ENABLE    (1 << 11)
+
+// IOAPIC: index register, data window 0x10 above it
+#define IOAPIC_VERSION      0x01
+#define IOAPIC_REDIRECT     0x10       // Two registers per input
+#define REDIRECT_LOW_ACTIVE (1 << 13)
+#define REDIRECT_LEVEL      (1 << 15)
+
+// Divide-by-16 timer clock; calibrated over this window
+#define TIMER_DIVIDE_16     0x3
+#define CALIBRATE_NS        10000000
+
+static volatile unsigned int* lapic = 0;
+static int active = 0;
+
+// Where each ISA IRQ is routed: IOAPIC base and input (base 0: unrouted)
+static unsigned int irq_ioapic[16];
+static unsigned int irq_pin[16];
+
+static unsigned int lapic_read(unsigned int reg) {
+    return lapic[reg / 4];
+}
+
+static void lapic_write(unsigned int reg, unsigned int value) {
+    lapic[reg / 4] = value;
+}
+
+static unsigned int ioapic_read(unsigned int base, unsigned int reg) {
+    *(volatile unsigned int*)base = reg;
+    return *(volatile unsigned int*)(base + 0x10);
+}
+
+static void ioapic_write(unsigned int base, unsigned int reg, unsigned int value) {
+    *(volatile unsigned int*)base = reg;
+    *(volatile unsigned int*)(base + 0x10) = value;
+}
+
+// IOAPIC serving a GSI, and its input number there
+static const acpi_ioapic_t* ioapic_for(const acpi_madt_t* madt, unsigned int gsi, unsigned int* pin) {
+    for (int i = 0; i < madt->ioapic_count; i++) {
+        const acpi_ioapic_t* ioapic = &madt->ioapics[i];
+        unsigned int inputs = ((ioapic_read(ioapic->address, IOAPIC_VERSION) >> 16) & 0xFF) + 1;
+        if (gsi >= ioapic->gsi_base && gsi < ioapic->gsi_base + inputs) {
+            *pin = gsi - ioapic->gsi_base;
+            return ioapic;
+        }
+    }
+    return 0;
+}
+
+// An ISA IRQ whose GSI another IRQ was moved onto (typically IRQ 2,
+// the cascade, once the PIT is overridden to GSI 2) must stay unrouted
+static int gsi_taken(const acpi_madt_t* madt, int irq) {
+    for (int other = 0; other < ACPI_ISA_IRQS; other++) {
+        if (other != irq && madt->isa_gsi[other] != (unsigned int)other &&
+            madt->isa_gsi[other] == madt->isa_gsi[irq]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Route ISA IRQs through the IOAPIC to vectors 32-47 on this CPU,
+// keeping the lines the PIC had enabled enabled
+static void ioapic_route_isa(const acpi_madt_t* madt, unsigned short enabled) {
+    unsigned int destination = apic_id() << 24;
+    
+    for (int irq = 0; irq < ACPI_ISA_IRQS; irq++) {
+        unsigned int pin;
+        const acpi_ioapic_t* ioapic;
+        
+        irq_ioapic[irq] = 0;
+        if (gsi_taken(madt, irq) && madt->isa_gsi[irq] == (unsigned int)irq) {
+            continue;
+        }
+        ioapic = ioapic_for(madt, madt->isa_gsi[irq], &pin);
+        if (!ioapic) {
+            continue;
+        }
+        
+        // ISA defaults are active high, edge triggered
+        unsigned int low = 32 + irq;
+        unsigned short flags = madt->isa_flags[irq];
+        if ((flags & ACPI_POLARITY_MASK) == ACPI_POLARITY_LOW) {
+            low |= REDIRECT_LOW_ACTIVE;
+        }
+        if ((flags & ACPI_TRIGGER_MASK) == ACPI_TRIGGER_LEVEL) {
+            low |= REDIRECT_LEVEL;
+        }
+        if (!(enabled & (1 << irq))) {
+            low |= LVT_MASKED;
+        }
+        
+        ioapic_write(ioapic->address, IOAPIC_REDIRECT + pin * 2 + 1, destination);
+        ioapic_write(ioapic->address, IOAPIC_REDIRECT + pin * 2, low);
+        irq_ioapic[irq] = ioapic->address;
+        irq_pin[irq] = pin;
+    }
+}
+
+// Switch interrupt delivery from the 8259 pair to the local APIC and
+// IOAPIC (returns 0, leaving the PIC in charge, if there is no APIC)
+int apic_init() {
+    if (active) {
+        return 1;
+    }
+    if (!cpu_has(CPU_FEATURE_APIC | CPU_FEATURE_MSR) || !acpi_init()) {
+        return 0;
+    }
+    const acpi_madt_t* madt = acpi_madt();
+    if (madt->ioapic_count == 0) {
+        return 0;
+    }
+    
+    // Registers are MMIO and must not be cached
+    paging_map_uc(madt->lapic_address, 0x1000);
+    for (int i = 0; i < madt->ioapic_count; i++) {
+        paging_map_uc(madt->ioapics[i].address, 0x20);
+    }
+    lapic = (volatile unsigned int*)madt->lapic_address;
+    
+    unsigned int flags = irq_save();
+    
+    // Mask the whole PIC; its enabled lines move to the IOAPIC
+    unsigned short enabled = ~pic_get_mask();
+    pic_set_mask(0xFFFF);
+    
+    apic_enable_local();
+    ioapic_route_isa(madt, enabled);
+    active = 1;
+    irq_restore(flags);
+    return 1;
+}
+
+// Enable the running CPU's local APIC with every local source masked
+// (the boot CPU from apic_init(), the others as they start)
+void apic_enable_local() {
+    wrmsr(MSR_APIC_BASE, rdmsr(MSR_APIC_BASE) | APIC_BASE_ENABLE);
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_LVT_LINT0, LVT_MASKED);
+    lapic_write(LAPIC_LVT_ERROR, LVT_MASKED);
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED);
+    lapic_write(LAPIC_SVR, LAPIC_ENABLE | LAPIC_SPURIOUS_VECTOR);
+}
+
+// Check whether the APIC delivers interrupts
+int apic_active() {
+    return active;
+}
+
+// Local APIC ID of the running CPU
+unsigned int apic_id() {
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+// End of interrupt: a single store instead of PIC port writes
+void apic_eoi() {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+static void ioapic_set_masked(int irq, int masked) {
+    if (irq < 0 || irq >= 16 || !irq_ioapic[irq]) {
+        return;
+    }
+    
+    unsigned int flags = irq_save();
+    unsigned int reg = IOAPIC_REDIRECT + irq_pin[irq] * 2;
+    unsigned int low = ioapic_read(irq_ioapic[irq], reg);
+    low = masked ? (low | LVT_MASKED) : (low & ~LVT_MASKED);
+    ioapic_write(irq_ioapic[irq], reg, low);
+    irq_restore(flags);
+}
+
+// Disable an ISA IRQ at the IOAPIC
+void ioapic_mask(int irq) {
+    ioapic_set_masked(irq, 1);
+}
+
+// Enable an ISA IRQ at the IOAPIC
+void ioapic_unmask(int irq) {
+    ioapic_set_masked(irq, 0);
+}
+
+// Run the LAPIC timer periodically at hz on LAPIC_TIMER_VECTOR. Its
+// rate is measured against the TSC, so this returns 0 (use the PIT)
+// without a calibrated TSC.
+int apic_timer_start(unsigned int hz) {
+    if (!active || !timer_tsc_hz() || hz == 0) {
+        return 0;
+    }
+    
+    lapic_write(LAPIC_TIMER_DIVIDE, TIMER_DIVIDE_16);
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INITIAL, 0xFFFFFFFF);
+    
+    unsigned long long start = rdtsc();
+    while (timer_cycles_to_ns(rdtsc() - start) < CALIBRATE_NS) {
+    }
+    unsigned int counted = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT);
+    lapic_write(LAPIC_TIMER_INITIAL, 0);
+    
+    // Counts per second = counted * 100, which stays in 32 bits for a
+    // divided clock up to 4 GHz, far above real bus rates
+    if (counted == 0 || counted > 40000000) {
+        return 0;
+    }
+    unsigned int per_tick = counted * (1000000000 / CALIBRATE_NS) / hz;
+    if (per_tick == 0) {
+        return 0;
+    }
+    
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_VECTOR | LVT_PERIODIC);
+    lapic_write(LAPIC_TIMER_INITIAL, per_tick);
+    return 1;
+}
+
+// Write the ICR and wait for the local APIC to accept the IPI
+static void icr_send(unsigned int high, unsigned int low) {
+    unsigned int flags = irq_save();
+    lapic_write(LAPIC_ICR_HIGH, high);
+    lapic_write(LAPIC_ICR_LOW, low);
+    while (lapic_read(LAPIC_ICR_LOW) & ICR_PENDING) {
+        cpu_pause();
+    }
+    irq_restore(flags);
+}
+
+// INIT IPI (assert, then deassert for older APICs)
+void apic_send_init(unsigned int id) {
+    icr_send(id << 24, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+    icr_send(id << 24, ICR_INIT | ICR_LEVEL);
+}
+
+// STARTUP IPI: the CPU starts in real mode at address (page aligned,
+// below 1 MB)
+void apic_send_startup(unsigned int id, unsigned int address) {
+    icr_send(id << 24, ICR_STARTUP | (address >> 12));
+}
+
+// Fixed interrupt to one CPU
+void apic_send_ipi(unsigned int id, int vector) {
+    icr_send(id << 24, vector);
+}
+
+// Fixed interrupt to every other CPU
+void apic_broadcast_ipi(int vector) {
+    icr_send(0, ICR_ALL_BUT_SELF | vector);
+}
@@ -0,0 +1,166 @@
+#include "../Lib/include/bench.h"
+#include "../Lib/include/graphics.h"
+#include "../Lib/include/serial.h"
+#include "../Lib/include/thread.h"
+#include "../Lib/include/cpu.h"
+#include "../Lib/include/io.h"
+
+// Screen region the drawing benchmarks use
+#define BENCH_X          64
+#define BENCH_Y          64
+#define BENCH_WIDTH      512
+#define BENCH_HEIGHT     256
+
+typedef struct {
+    const char* name;
+    void (*setup)();               // Untimed preparation, or 0
+    void (*run)(int i);            // One timed iteration
+    int iterations;
+    int hashed;                    // Hash the region afterwards
+} bench_t;
+
+static const color_t bench_fg = {0xE0, 0xE0, 0xE0, 255};
+static const color_t bench_bg = {0x40, 0x20, 0x10, 255};
+
+static void fill_rect_run(int i) {
+    graphics_fill_rect(BENCH_X, BENCH_Y, BENCH_WIDTH, BENCH_HEIGHT, (color_t){0x40, 0x80, 0xC0, 255});
+}
+
+static void fill_rect_alpha_run(int i) {
+    graphics_fill_rect(BENCH_X, BENCH_Y, BENCH_WIDTH, BENCH_HEIGHT, (color_t){0xC0, 0x80, 0x40, 128});
+}
+
+// One glyph per iteration, filling the region 64 cells by 32 rows
+static void draw_char_run(int i) {
+    int cell = i % (64 * 32);
+    graphics_draw_char(BENCH_X + (cell % 64) * 8, BENCH_Y + (cell / 64) * 8,
+                       32 + i % 95, bench_fg, bench_bg);
+}
+
+static const char bench_text[] =
+    "The quick brown fox jumps over the lazy dog 0123456789 !@#$%^&*"
+    "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG";
+
+// One 64-character line per iteration
+static void draw_text_run(int i) {
+    graphics_draw_text(BENCH_X, BENCH_Y + (i % 32) * 8, bench_text, 64, bench_fg, bench_bg);
+}
+
+static void draw_line_run(int i) {
+    int y = i % BENCH_HEIGHT;
+    graphics_draw_line(BENCH_X, BENCH_Y + y, BENCH_X + BENCH_WIDTH - 1,
+                       BENCH_Y + BENCH_HEIGHT - 1 - y, bench_fg);
+}
+
+// A different line of text on every row, so the result shows whether
+// each row landed in the right place
+static void scroll_rect_setup() {
+    for (int row = 0; row < 32; row++) {
+        graphics_draw_text(BENCH_X, BENCH_Y + row * 8, bench_text + row, 64, bench_fg, bench_bg);
+    }
+}
+
+static void scroll_rect_run(int i) {
+    graphics_scroll_rect(BENCH_X, BENCH_Y, BENCH_WIDTH, BENCH_HEIGHT, 8);
+}
+
+// Whole-screen copy to the framebuffer
+static void present_full_run(int i) {
+    graphics_mark_dirty(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    graphics_present();
+}
+
+// Software interrupt through irq_common_stub and the scheduler and back
+static void irq_yield_run(int i) {
+    thread_yield();
+}
+
+static const bench_t benches[] = {
+    {"fill_rect",       0,                 fill_rect_run,       64,   1},
+    {"fill_rect_alpha", 0,                 fill_rect_alpha_run, 64,   1},
+    {"draw_char",       0,                 draw_char_run,       2048, 1},
+    {"draw_text",       0,                 draw_text_run,       256,  1},
+    {"draw_line",       0,                 draw_line_run,       256,  1},
+    {"scroll_rect",     scroll_rect_setup, scroll_rect_run,     64,   1},
+    {"present_full",    0,                 present_full_run,    16,   0},
+    {"irq_yield",       0,                 irq_yield_run,       1024, 0},
+};
+
+#define BENCH_COUNT ((int)(sizeof(benches) / sizeof(benches[0])))
+
+// FNV-1a over the presented region
+static unsigned int region_hash() {
+    const unsigned int* fb = graphics_get_framebuffer();
+    unsigned int hash = 2166136261u;
+
+    for (int y = BENCH_Y; y < BENCH_Y + BENCH_HEIGHT; y++) {
+        const unsigned int* row = fb + y * SCREEN_WIDTH;
+        for (int x = BENCH_X; x < BENCH_X + BENCH_WIDTH; x++) {
+            // Only the color channels; the top byte is not displayed
+            unsigned int pixel = row[x] & 0x00FFFFFF;
+            for (int b = 0; b < 3; b++) {
+                hash = (hash ^ (pixel & 0xFF)) * 16777619u;
+                pixel >>= 8;
+            }
+        }
+    }
+    return hash;
+}
+
+int bench_count() {
+    return BENCH_COUNT;
+}
+
+// Run benchmark index and fill in result (returns 0 if there is none,
+// or no TSC to time it with). The first iteration runs untimed to warm
+// caches; the rest are timed one by one, so min_cycles is free of
+// interrupts that land in between.
+int bench_run(int index, bench_result_t* result) {
+    if (index < 0 || index >= BENCH_COUNT || !cpu_has(CPU_FEATURE_TSC)) {
+        return 0;
+    }
+
+    const bench_t* bench = &benches[index];
+    unsigned long long total = 0;
+    unsigned int min = 0xFFFFFFFF;
+
+    // Drawing starts from the same pixels every time
+    if (bench->hashed) {
+        graphics_fill_rect(BENCH_X, BENCH_Y, BENCH_WIDTH, BENCH_HEIGHT, COLOR_BLACK);
+    }
+    if (bench->setup) {
+        bench->setup();
+    }
+    bench->run(0);
+
+    for (int i = 1; i <= bench->iterations; i++) {
+        unsigned long long start = rdtsc();
+        bench->run(i);
+        unsigned long long elapsed = rdtsc() - start;
+
+        unsigned int cycles = elapsed >> 32 ? 0xFFFFFFFF : (unsigned int)elapsed;
+        if (cycles < min) {
+            min = cycles;
+        }
+        total += cycles;
+    }
+
+    result->name = bench->name;
+    result->iterations = bench->iterations;
+    result->min_cycles = min;
+    result->avg_cycles = div64_32(total, bench->iterations);
+    result->hashed = bench->hashed;
+    result->hash = 0;
+    if (bench->hashed) {
+        graphics_present();
+        result->hash = region_hash();
+    }
+    return 1;
+}
+
+// Leave QEMU through isa-debug-exit once the serial output is out; its
+// exit status is (code << 1) | 1. Returns if the device is not there.
+void bench_exit(int code) {
+    serial_flush();
+    outb(BENCH_EXIT_PORT, code);
+}
@@ -0,0 +1,55 @@
+#include "../Lib/include/boottime.h"
+#include "../Lib/include/cpu.h"
+
+static const char* loader_phases[BOOT_LOADER_STAMPS] = {
+    "firmware",                    // Reset to boot sector
+    "boot sector",                 // VESA mode, E820 map, stage 2 read
+    "kernel read",                 // Disk reads into the staging area
+    "kernel unpack"                // Decompress and place segments
+};
+
+static boottime_mark_t marks[BOOTTIME_MAX_MARKS];
+static int mark_count = 0;
+
+// Start the list with the loaders' stamps (none without boot info)
+void boottime_init(const boot_info_t* info) {
+    mark_count = 0;
+    if (!info) {
+        return;
+    }
+    for (int i = 0; i < BOOT_LOADER_STAMPS; i++) {
+        if (info->loader_tsc[i]) {
+            marks[mark_count].name = loader_phases[i];
+            marks[mark_count].tsc = info->loader_tsc[i];
+            mark_count++;
+        }
+    }
+}
+
+// End the phase called name now (not recorded without a TSC)
+void boottime_mark(const char* name) {
+    if (!cpu_has(CPU_FEATURE_TSC)) {
+        return;
+    }
+    
+    unsigned int flags = irq_save();
+    if (mark_count < BOOTTIME_MAX_MARKS) {
+        marks[mark_count].name = name;
+        marks[mark_count].tsc = rdtsc();
+        mark_count++;
+    }
+    irq_restore(flags);
+}
+
+// Copy up to max marks into out; returns the count
+int boottime_marks(boottime_mark_t* out, int max) {
+    int count = 0;
+    
+    unsigned int flags = irq_save();
+    while (count < mark_count && count < max) {
+        out[count] = marks[count];
+        count++;
+    }
+    irq_restore(flags);
+    return count;
+}
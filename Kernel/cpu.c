@@ -0,0 +1,63 @@
+#include "../Lib/include/cpu.h"
+
+// Cached CPUID leaf 1 EDX (detected on first use)
+static unsigned int features = 0;
+static int features_valid = 0;
+
+// SSE state enabled in CR0/CR4
+static int sse_enabled = 0;
+
+// Get CPUID feature bits
+unsigned int cpu_features() {
+    if (!features_valid) {
+        unsigned int eax, ebx, ecx, edx;
+        cpuid(1, &eax, &ebx, &ecx, &edx);
+        features = edx;
+        features_valid = 1;
+    }
+    return features;
+}
+
+// Check for a CPUID feature bit
+int cpu_has(unsigned int feature) {
+    return (cpu_features() & feature) == feature;
+}
+
+// Program this CPU's control registers for SSE
+static void sse_setup() {
+    unsigned int cr0, cr4;
+    
+    // CR0: clear EM (no emulation), set MP (monitor coprocessor)
+    __asm__ __volatile__("mov %%cr0, %0" : "=r"(cr0));
+    cr0 &= ~(1 << 2);
+    cr0 |= (1 << 1);
+    __asm__ __volatile__("mov %0, %%cr0" : : "r"(cr0));
+    
+    // CR4: set OSFXSR and OSXMMEXCPT
+    __asm__ __volatile__("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= (1 << 9) | (1 << 10);
+    __asm__ __volatile__("mov %0, %%cr4" : : "r"(cr4));
+    
+    __asm__ __volatile__("fninit");
+}
+
+// Enable SSE instructions (returns 0 if the CPU lacks SSE/FXSR)
+int cpu_enable_sse() {
+    if (sse_enabled) {
+        return 1;
+    }
+    if (!cpu_has(CPU_FEATURE_SSE | CPU_FEATURE_FXSR)) {
+        return 0;
+    }
+    
+    sse_setup();
+    sse_enabled = 1;
+    return 1;
+}
+
+// Give an application processor the features the boot CPU enabled
+void cpu_init_ap() {
+    if (sse_enabled) {
+        sse_setup();
+    }
+}
@@ -0,0 +1,297 @@
+#include "../../Lib/include/blend.h"
+#include "../../Lib/include/cpu.h"
+
+// Constants for the SSE2 kernels
+static const unsigned short sse_round[8] __attribute__((aligned(16))) = {
+    128, 128, 128, 128, 128, 128, 128, 128
+};
+static const unsigned short sse_div255[8] __attribute__((aligned(16))) = {
+    257, 257, 257, 257, 257, 257, 257, 257
+};
+static const unsigned short sse_inv[8] __attribute__((aligned(16))) = {
+    255, 255, 255, 255, 255, 255, 255, 255
+};
+static const unsigned int sse_alpha[4] __attribute__((aligned(16))) = {
+    0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000
+};
+
+// Glyph row nibble (bit 3 = leftmost pixel) to per-pixel select masks
+static const unsigned int sse_nibble_mask[16][4] __attribute__((aligned(16))) = {
+    {0, 0, 0, 0},                          {0, 0, 0, ~0u},
+    {0, 0, ~0u, 0},                        {0, 0, ~0u, ~0u},
+    {0, ~0u, 0, 0},                        {0, ~0u, 0, ~0u},
+    {0, ~0u, ~0u, 0},                      {0, ~0u, ~0u, ~0u},
+    {~0u, 0, 0, 0},                        {~0u, 0, 0, ~0u},
+    {~0u, 0, ~0u, 0},                      {~0u, 0, ~0u, ~0u},
+    {~0u, ~0u, 0, 0},                      {~0u, ~0u, 0, ~0u},
+    {~0u, ~0u, ~0u, 0},                    {~0u, ~0u, ~0u, ~0u},
+};
+
+// Composite one premultiplied pixel over one destination pixel
+static inline unsigned int blend_pixel(unsigned int dst, unsigned int src) {
+    unsigned int inv = 255 - (src >> 24);
+    unsigned int r = ((src >> 16) & 0xFF) + blend_mul255((dst >> 16) & 0xFF, inv);
+    unsigned int g = ((src >> 8) & 0xFF) + blend_mul255((dst >> 8) & 0xFF, inv);
+    unsigned int b = (src & 0xFF) + blend_mul255(dst & 0xFF, inv);
+    return 0xFF000000 | (r << 16) | (g << 8) | b;
+}
+
+// Scalar reference kernels
+
+static void blend_row_scalar(unsigned int* dst, unsigned int src, int count) {
+    for (int i = 0; i < count; i++) {
+        dst[i] = blend_pixel(dst[i], src);
+    }
+}
+
+static void blend_span_scalar(unsigned int* dst, const unsigned int* src, int count) {
+    for (int i = 0; i < count; i++) {
+        dst[i] = blend_pixel(dst[i], src[i]);
+    }
+}
+
+static void blend_mask_scalar(unsigned int* dst, unsigned int src, unsigned int bits) {
+    for (int i = 0; i < 8; i++) {
+        if (bits & (1 << (7 - i))) {
+            dst[i] = blend_pixel(dst[i], src);
+        }
+    }
+}
+
+// SSE2 kernels: four pixels per iteration, unpacked to 16-bit lanes.
+// Per lane: t = dst * inv + 128; out = src + ((t * 257) >> 16)
+
+__attribute__((target("sse2")))
+static void blend_row_sse2(unsigned int* dst, unsigned int src, int count) {
+    unsigned int inv = 255 - (src >> 24);
+    unsigned int inv2 = inv | (inv << 16);
+    int blocks = count >> 2;
+
+    __asm__ __volatile__(
+        "movd %2, %%xmm6\n\t"
+        "pshufd $0, %%xmm6, %%xmm6\n\t"
+        "movd %3, %%xmm5\n\t"
+        "pshufd $0, %%xmm5, %%xmm5\n\t"
+        "movdqa %4, %%xmm4\n\t"
+        "movdqa %5, %%xmm3\n\t"
+        "movdqa %6, %%xmm2\n\t"
+        "pxor %%xmm7, %%xmm7\n\t"
+        "test %1, %1\n\t"
+        "jz 2f\n\t"
+        "1:\n\t"
+        "movdqu (%0), %%xmm0\n\t"
+        "movdqa %%xmm0, %%xmm1\n\t"
+        "punpcklbw %%xmm7, %%xmm0\n\t"
+        "punpckhbw %%xmm7, %%xmm1\n\t"
+        "pmullw %%xmm6, %%xmm0\n\t"
+        "pmullw %%xmm6, %%xmm1\n\t"
+        "paddw %%xmm4, %%xmm0\n\t"
+        "paddw %%xmm4, %%xmm1\n\t"
+        "pmulhuw %%xmm3, %%xmm0\n\t"
+        "pmulhuw %%xmm3, %%xmm1\n\t"
+        "packuswb %%xmm1, %%xmm0\n\t"
+        "paddb %%xmm5, %%xmm0\n\t"
+        "por %%xmm2, %%xmm0\n\t"
+        "movdqu %%xmm0, (%0)\n\t"
+        "add $16, %0\n\t"
+        "dec %1\n\t"
+        "jnz 1b\n\t"
+        "2:\n\t"
+        : "+r"(dst), "+r"(blocks)
+        : "r"(inv2), "r"(src), "m"(sse_round), "m"(sse_div255), "m"(sse_alpha)
+        : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", "memory", "cc");
+
+    blend_row_scalar(dst, src, count & 3);
+}
+
+__attribute__((target("sse2")))
+static void blend_span_sse2(unsigned int* dst, const unsigned int* src, int count) {
+    int blocks = count >> 2;
+
+    __asm__ __volatile__(
+        "movdqa %3, %%xmm4\n\t"
+        "movdqa %4, %%xmm3\n\t"
+        "movdqa %5, %%xmm2\n\t"
+        "pxor %%xmm7, %%xmm7\n\t"
+        "test %2, %2\n\t"
+        "jz 2f\n\t"
+        "1:\n\t"
+        // Per-pixel inverse alpha broadcast to its four lanes
+        "movdqu (%1), %%xmm5\n\t"
+        "movdqa %%xmm5, %%xmm6\n\t"
+        "punpcklbw %%xmm7, %%xmm6\n\t"
+        "pshuflw $0xFF, %%xmm6, %%xmm6\n\t"
+        "pshufhw $0xFF, %%xmm6, %%xmm6\n\t"
+        "pxor %6, %%xmm6\n\t"
+        "movdqu (%0), %%xmm0\n\t"
+        "movdqa %%xmm0, %%xmm1\n\t"
+        "punpcklbw %%xmm7, %%xmm0\n\t"
+        "punpckhbw %%xmm7, %%xmm1\n\t"
+        "pmullw %%xmm6, %%xmm0\n\t"
+        "movdqa %%xmm5, %%xmm6\n\t"
+        "punpckhbw %%xmm7, %%xmm6\n\t"
+        "pshuflw $0xFF, %%xmm6, %%xmm6\n\t"
+        "pshufhw $0xFF, %%xmm6, %%xmm6\n\t"
+        "pxor %6, %%xmm6\n\t"
+        "pmullw %%xmm6, %%xmm1\n\t"
+        "paddw %%xmm4, %%xmm0\n\t"
+        "paddw %%xmm4, %%xmm1\n\t"
+        "pmulhuw %%xmm3, %%xmm0\n\t"
+        "pmulhuw %%xmm3, %%xmm1\n\t"
+        "packuswb %%xmm1, %%xmm0\n\t"
+        "paddb %%xmm5, %%xmm0\n\t"
+        "por %%xmm2, %%xmm0\n\t"
+        "movdqu %%xmm0, (%0)\n\t"
+        "add $16, %0\n\t"
+        "add $16, %1\n\t"
+        "dec %2\n\t"
+        "jnz 1b\n\t"
+        "2:\n\t"
+        : "+r"(dst), "+r"(src), "+r"(blocks)
+        : "m"(sse_round), "m"(sse_div255), "m"(sse_alpha), "m"(sse_inv)
+        : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", "memory", "cc");
+
+    blend_span_scalar(dst, src, count & 3);
+}
+
+__attribute__((target("sse2")))
+static void blend_mask_sse2(unsigned int* dst, unsigned int src, unsigned int bits) {
+    unsigned int inv = 255 - (src >> 24);
+    unsigned int inv2 = inv | (inv << 16);
+    const unsigned int* mask_lo = sse_nibble_mask[(bits >> 4) & 0xF];
+    const unsigned int* mask_hi = sse_nibble_mask[bits & 0xF];
+
+    // Blend all eight pixels, then keep only the ones the glyph row covers
+    __asm__ __volatile__(
+        "movd %1, %%xmm6\n\t"
+        "pshufd $0, %%xmm6, %%xmm6\n\t"
+        "movd %2, %%xmm5\n\t"
+        "pshufd $0, %%xmm5, %%xmm5\n\t"
+        "movdqa %5, %%xmm4\n\t"
+        "movdqa %6, %%xmm3\n\t"
+        "pxor %%xmm7, %%xmm7\n\t"
+        "movdqu (%0), %%xmm0\n\t"
+        "movdqu 16(%0), %%xmm2\n\t"
+        // Pixels 0-3
+        "movdqa %%xmm0, %%xmm1\n\t"
+        "punpcklbw %%xmm7, %%xmm0\n\t"
+        "punpckhbw %%xmm7, %%xmm1\n\t"
+        "pmullw %%xmm6, %%xmm0\n\t"
+        "pmullw %%xmm6, %%xmm1\n\t"
+        "paddw %%xmm4, %%xmm0\n\t"
+        "paddw %%xmm4, %%xmm1\n\t"
+        "pmulhuw %%xmm3, %%xmm0\n\t"
+        "pmulhuw %%xmm3, %%xmm1\n\t"
+        "packuswb %%xmm1, %%xmm0\n\t"
+        "paddb %%xmm5, %%xmm0\n\t"
+        "por %7, %%xmm0\n\t"
+        "movdqu (%0), %%xmm1\n\t"
+        "pand (%3), %%xmm0\n\t"
+        "movdqa (%3), %%xmm7\n\t"
+        "pandn %%xmm1, %%xmm7\n\t"
+        "por %%xmm7, %%xmm0\n\t"
+        "movdqu %%xmm0, (%0)\n\t"
+        // Pixels 4-7
+        "pxor %%xmm7, %%xmm7\n\t"
+        "movdqa %%xmm2, %%xmm0\n\t"
+        "movdqa %%xmm2, %%xmm1\n\t"
+        "punpcklbw %%xmm7, %%xmm0\n\t"
+        "punpckhbw %%xmm7, %%xmm1\n\t"
+        "pmullw %%xmm6, %%xmm0\n\t"
+        "pmullw %%xmm6, %%xmm1\n\t"
+        "paddw %%xmm4, %%xmm0\n\t"
+        "paddw %%xmm4, %%xmm1\n\t"
+        "pmulhuw %%xmm3, %%xmm0\n\t"
+        "pmulhuw %%xmm3, %%xmm1\n\t"
+        "packuswb %%xmm1, %%xmm0\n\t"
+        "paddb %%xmm5, %%xmm0\n\t"
+        "por %7, %%xmm0\n\t"
+        "pand (%4), %%xmm0\n\t"
+        "movdqa (%4), %%xmm7\n\t"
+        "pandn %%xmm2, %%xmm7\n\t"
+        "por %%xmm7, %%xmm0\n\t"
+        "movdqu %%xmm0, 16(%0)\n\t"
+        :
+        : "r"(dst), "r"(inv2), "r"(src), "r"(mask_lo), "r"(mask_hi),
+          "m"(sse_round), "m"(sse_div255), "m"(sse_alpha)
+        : "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", "memory");
+}
+
+// Selected kernels (scalar until blend_init finds SSE2)
+static blend_row_fn row_kernel = blend_row_scalar;
+static blend_span_fn span_kernel = blend_span_scalar;
+static blend_mask_fn mask_kernel = blend_mask_scalar;
+static int using_sse2 = 0;
+
+// Select kernels by CPUID
+void blend_init() {
+    if (cpu_has(CPU_FEATURE_SSE2) && cpu_enable_sse()) {
+        row_kernel = blend_row_sse2;
+        span_kernel = blend_span_sse2;
+        mask_kernel = blend_mask_sse2;
+        using_sse2 = 1;
+    } else {
+        row_kernel = blend_row_scalar;
+        span_kernel = blend_span_scalar;
+        mask_kernel = blend_mask_scalar;
+        using_sse2 = 0;
+    }
+}
+
+// Check which kernels are active
+int blend_using_sse2() {
+    return using_sse2;
+}
+
+// Solid premultiplied color over count pixels
+void blend_row(unsigned int* dst, unsigned int src, int count) {
+    unsigned int alpha = src >> 24;
+
+    if (alpha == 0 || count <= 0) {
+        return;
+    }
+    if (alpha == 255) {
+        for (int i = 0; i < count; i++) {
+            dst[i] = src;
+        }
+        return;
+    }
+    row_kernel(dst, src, count);
+}
+
+// Solid premultiplied color over a rectangle
+void blend_rect(unsigned int* dst, int pitch, int width, int height, unsigned int src) {
+    for (int y = 0; y < height; y++) {
+        blend_row(dst, src, width);
+        dst += pitch;
+    }
+}
+
+// Per-pixel premultiplied sources over count pixels
+void blend_span(unsigned int* dst, const unsigned int* src, int count) {
+    if (count > 0) {
+        span_kernel(dst, src, count);
+    }
+}
+
+// Solid premultiplied color through a glyph row mask
+void blend_mask(unsigned int* dst, unsigned int src, unsigned int bits, int count) {
+    unsigned int alpha = src >> 24;
+
+    if (count < 8) {
+        // Clipped edge glyph: drop the bits past count
+        bits &= (0xFF << (8 - count)) & 0xFF;
+    }
+    if (alpha == 0 || bits == 0) {
+        return;
+    }
+    if (count == 8) {
+        mask_kernel(dst, src, bits);
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        if (bits & (1 << (7 - i))) {
+            dst[i] = blend_pixel(dst[i], src);
+        }
+    }
+}
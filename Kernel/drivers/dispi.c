@@ -0,0 +1,59 @@
+#include "../../Lib/include/dispi.h"
+
+// Read a DISPI register
+unsigned short dispi_read(unsigned short index) {
+    unsigned short value;
+    __asm__ __volatile__("outw %0, %1" : : "a"(index), "Nd"((unsigned short)DISPI_INDEX_PORT));
+    __asm__ __volatile__("inw %1, %0" : "=a"(value) : "Nd"((unsigned short)DISPI_DATA_PORT));
+    return value;
+}
+
+// Write a DISPI register
+void dispi_write(unsigned short index, unsigned short value) {
+    __asm__ __volatile__("outw %0, %1" : : "a"(index), "Nd"((unsigned short)DISPI_INDEX_PORT));
+    __asm__ __volatile__("outw %0, %1" : : "a"(value), "Nd"((unsigned short)DISPI_DATA_PORT));
+}
+
+// Check for a DISPI interface with display offsets (returns 0 on other
+// adapters, where the ports float and read back 0xFFFF)
+int dispi_detect() {
+    unsigned short id = dispi_read(DISPI_INDEX_ID);
+    return id >= DISPI_ID2 && id <= DISPI_ID5;
+}
+
+// Make room for pages stacked vertically in video memory, keeping the
+// mode the bootloader set. Returns 0 if the mode does not match or the
+// memory is too small.
+int dispi_setup_pages(int width, int height, int bpp, int pages) {
+    if (dispi_read(DISPI_INDEX_XRES) != width ||
+        dispi_read(DISPI_INDEX_YRES) != height ||
+        dispi_read(DISPI_INDEX_BPP) != bpp) {
+        return 0;
+    }
+    
+    // Video memory size (assume 4 MB on interfaces without the register)
+    unsigned int memory = 4 * 1024 * 1024;
+    if (dispi_read(DISPI_INDEX_ID) >= DISPI_ID4) {
+        memory = (unsigned int)dispi_read(DISPI_INDEX_VIDEO_MEMORY_64K) * 64 * 1024;
+    }
+    if ((unsigned int)width * height * (bpp / 8) * pages > memory) {
+        return 0;
+    }
+    
+    // The adapter clamps the virtual size to what fits; read it back
+    dispi_write(DISPI_INDEX_VIRT_WIDTH, width);
+    dispi_write(DISPI_INDEX_VIRT_HEIGHT, height * pages);
+    if (dispi_read(DISPI_INDEX_VIRT_WIDTH) != width ||
+        dispi_read(DISPI_INDEX_VIRT_HEIGHT) < height * pages) {
+        return 0;
+    }
+    
+    dispi_write(DISPI_INDEX_X_OFFSET, 0);
+    dispi_write(DISPI_INDEX_Y_OFFSET, 0);
+    return 1;
+}
+
+// Show the virtual screen from line y down
+void dispi_set_y_offset(int y) {
+    dispi_write(DISPI_INDEX_Y_OFFSET, y);
+}
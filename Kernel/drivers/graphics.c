@@ -1,8 +1,69 @@
 #include "../../Lib/include/graphics.h"
+#include "../../Lib/include/blend.h"
+#include "../../Lib/include/cpu.h"
+#include "../../Lib/include/dispi.h"
+#include "../../Lib/include/paging.h"
+#include "../../Lib/include/pmm.h"
+#include "../../Lib/include/smp.h"
 
 // Framebuffer pointer (will be set by bootloader)
 static unsigned int* framebuffer = 0;
 
+// Back buffer in system RAM, allocated from the frame allocator (or at a
+// fixed address above the kernel when there is no memory map).
+// All drawing goes here; graphics_present() copies the damage to the LFB
+// so video memory is only ever written, never read.
+#define BACKBUFFER_ADDR 0x00400000
+#define SURFACE_FRAMES (SCREEN_WIDTH * SCREEN_HEIGHT * 4 / FRAME_SIZE)
+static unsigned int* backbuffer = (unsigned int*)BACKBUFFER_ADDR;
+
+// Dirty rectangles waiting for the next graphics_present()
+#define MAX_DIRTY_RECTS 32
+static rect_t dirty_rects[MAX_DIRTY_RECTS];
+static int dirty_count = 0;
+
+// Page flipping (Bochs/QEMU DISPI): the virtual screen is two pages
+// tall and framebuffer is the page on screen. Presenting copies the
+// damage from the back buffer into the hidden page and moves the display
+// offset to it. Each page also takes the rects of the previous present,
+// which went to the other page only.
+static int page_flip = 0;
+static int back_page = 0;
+static unsigned int* pages[2];
+static rect_t missed_rects[MAX_DIRTY_RECTS];
+static int missed_count = 0;
+
+// Wallpaper is rendered once into its own surface; clearing or erasing
+// a region is then a copy from here instead of a regeneration
+// (allocated like the back buffer)
+#define WALLPAPER_ADDR 0x00700000
+static unsigned int* wallpaper = (unsigned int*)WALLPAPER_ADDR;
+static int wallpaper_ready = 0;
+
+// The wallpaper with one translucent color blended over it (the
+// terminal's background), so a translucent cell background is a copy
+// instead of a copy and a blend. Built on first use for the last tint
+// asked for.
+#define TINTED_ADDR 0x00A00000
+static unsigned int* tinted = 0;
+static unsigned int tinted_value = 0;      // Premultiplied tint
+static int tinted_ready = 0;
+
+// Fills at least this many pixels use non-temporal stores (when SSE2 is
+// available) so a full-screen clear does not evict the whole cache
+#define STREAM_FILL_MIN_PIXELS (64 * 1024)
+static int stream_fill = 0;
+
+// Clears, wallpaper rendering and flushes of at least this many pixels
+// are split into row bands, one per CPU
+#define PARALLEL_MIN_PIXELS (128 * 1024)
+
+// Clip rectangle for fills, lines and text (x1/y1 exclusive)
+static int clip_x0 = 0;
+static int clip_y0 = 0;
+static int clip_x1 = SCREEN_WIDTH;
+static int clip_y1 = SCREEN_HEIGHT;
+
 // Simple 8x8 bitmap font
 static unsigned char font_8x8[128][8] = {
     // Space (32)
@@ -99,26 +160,331 @@ static unsigned char font_8x8[128][8] = {
     [95] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7E, 0x00}, // _ (underscore)
 };
 
+// Pack a color into a framebuffer pixel
+static inline unsigned int pack_color(color_t color) {
+    return (color.a << 24) | (color.r << 16) | (color.g << 8) | color.b;
+}
+
+// Unpack a framebuffer pixel into a color
+static inline color_t unpack_color(unsigned int pixel) {
+    color_t color;
+    color.b = pixel & 0xFF;
+    color.g = (pixel >> 8) & 0xFF;
+    color.r = (pixel >> 16) & 0xFF;
+    color.a = (pixel >> 24) & 0xFF;
+    return color;
+}
+
+// Copy count dwords with a single string instruction
+static inline void copy_dwords(unsigned int* dst, const unsigned int* src, int count) {
+    __asm__ __volatile__("rep movsl" : "+D"(dst), "+S"(src), "+c"(count) : : "memory");
+}
+
+// Fill count dwords with a single string instruction
+static inline void fill_dwords(unsigned int* dst, unsigned int value, int count) {
+    __asm__ __volatile__("rep stosl" : "+D"(dst), "+c"(count) : "a"(value) : "memory");
+}
+
+// Fill count dwords with non-temporal 128-bit stores
+__attribute__((target("sse2")))
+static void stream_dwords(unsigned int* dst, unsigned int value, int count) {
+    // Scalar head up to 16-byte alignment
+    while (count > 0 && ((unsigned int)dst & 15)) {
+        *dst++ = value;
+        count--;
+    }
+    
+    int blocks = count >> 4;
+    if (blocks > 0) {
+        __asm__ __volatile__(
+            "movd %2, %%xmm0\n\t"
+            "pshufd $0, %%xmm0, %%xmm0\n\t"
+            "1:\n\t"
+            "movntdq %%xmm0, (%0)\n\t"
+            "movntdq %%xmm0, 16(%0)\n\t"
+            "movntdq %%xmm0, 32(%0)\n\t"
+            "movntdq %%xmm0, 48(%0)\n\t"
+            "add $64, %0\n\t"
+            "dec %1\n\t"
+            "jnz 1b\n\t"
+            "sfence\n\t"
+            : "+r"(dst), "+r"(blocks)
+            : "r"(value)
+            : "xmm0", "memory", "cc");
+    }
+    
+    fill_dwords(dst, value, count & 15);
+}
+
+// Fill a span, streaming past the cache when it is large
+static inline void fill_span(unsigned int* dst, unsigned int value, int count) {
+    if (stream_fill && count >= STREAM_FILL_MIN_PIXELS) {
+        stream_dwords(dst, value, count);
+    } else {
+        fill_dwords(dst, value, count);
+    }
+}
+
+// Clip a rectangle to bounds (returns 0 if nothing is left)
+static inline int clip_rect_to(int* x, int* y, int* width, int* height,
+                               int x0, int y0, int x1, int y1) {
+    if (*x < x0) { *width -= x0 - *x; *x = x0; }
+    if (*y < y0) { *height -= y0 - *y; *y = y0; }
+    if (*x + *width > x1) *width = x1 - *x;
+    if (*y + *height > y1) *height = y1 - *y;
+    return *width > 0 && *height > 0;
+}
+
+// Clip a rectangle to the current clip rectangle
+static inline int clip_rect(int* x, int* y, int* width, int* height) {
+    return clip_rect_to(x, y, width, height, clip_x0, clip_y0, clip_x1, clip_y1);
+}
+
+// Rectangle helpers for the damage tracker
+static inline int rect_area(const rect_t* r) {
+    return r->width * r->height;
+}
+
+static rect_t rect_union(const rect_t* a, const rect_t* b) {
+    rect_t u;
+    int right = a->x + a->width > b->x + b->width ? a->x + a->width : b->x + b->width;
+    int bottom = a->y + a->height > b->y + b->height ? a->y + a->height : b->y + b->height;
+    u.x = a->x < b->x ? a->x : b->x;
+    u.y = a->y < b->y ? a->y : b->y;
+    u.width = right - u.x;
+    u.height = bottom - u.y;
+    return u;
+}
+
+static inline int rect_contains(const rect_t* outer, const rect_t* inner) {
+    return inner->x >= outer->x && inner->y >= outer->y &&
+           inner->x + inner->width <= outer->x + outer->width &&
+           inner->y + inner->height <= outer->y + outer->height;
+}
+
+// Merge two rects only if the bounding box wastes at most 25% extra area,
+// so distant updates (e.g. cursor and status line) stay separate copies
+static inline int rect_should_merge(const rect_t* a, const rect_t* b) {
+    rect_t u = rect_union(a, b);
+    int sum = rect_area(a) + rect_area(b);
+    return rect_area(&u) <= sum + sum / 4;
+}
+
+// Mark a region of the back buffer as needing a copy to the framebuffer
+void graphics_mark_dirty(int x, int y, int width, int height) {
+    if (!clip_rect_to(&x, &y, &width, &height, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT)) {
+        return;
+    }
+    
+    rect_t r = {x, y, width, height};
+    
+    // Already covered (the common case for per-pixel updates)
+    for (int i = 0; i < dirty_count; i++) {
+        if (rect_contains(&dirty_rects[i], &r)) {
+            return;
+        }
+    }
+    
+    // Absorb overlapping/adjacent rects; a merge can grow r into others, so rescan
+    int i = 0;
+    while (i < dirty_count) {
+        if (rect_should_merge(&dirty_rects[i], &r)) {
+            r = rect_union(&dirty_rects[i], &r);
+            dirty_rects[i] = dirty_rects[--dirty_count];
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+    
+    // List full: fold into the rect whose bounding box grows the least
+    if (dirty_count == MAX_DIRTY_RECTS) {
+        int best = 0;
+        int best_growth = 0x7FFFFFFF;
+        for (i = 0; i < dirty_count; i++) {
+            rect_t u = rect_union(&dirty_rects[i], &r);
+            int growth = rect_area(&u) - rect_area(&dirty_rects[i]);
+            if (growth < best_growth) {
+                best_growth = growth;
+                best = i;
+            }
+        }
+        r = rect_union(&dirty_rects[best], &r);
+        dirty_rects[best] = dirty_rects[--dirty_count];
+    }
+    
+    dirty_rects[dirty_count++] = r;
+}
+
+// Rows [*band_y, *band_y + *band_height) of part index of count of the
+// rows [y, y + height)
+static void band_rows(int y, int height, int index, int count, int* band_y, int* band_height) {
+    int first = y + height * index / count;
+    int last = y + height * (index + 1) / count;
+    *band_y = first;
+    *band_height = last - first;
+}
+
+// Copy rows [y, y + height) of a dirty rectangle to the framebuffer
+static void present_rows(const rect_t* r, int y, int height) {
+    int offset = y * SCREEN_WIDTH + r->x;
+    
+    if (r->width == SCREEN_WIDTH) {
+        // Full-width band is contiguous: one copy
+        copy_dwords(framebuffer + offset, backbuffer + offset, r->width * height);
+    } else {
+        for (int row = 0; row < height; row++) {
+            copy_dwords(framebuffer + offset, backbuffer + offset, r->width);
+            offset += SCREEN_WIDTH;
+        }
+    }
+}
+
+// smp_run() part: one band of a large dirty rectangle
+static void present_band(void* arg, int index, int count) {
+    const rect_t* r = arg;
+    int y, height;
+    band_rows(r->y, r->height, index, count, &y, &height);
+    present_rows(r, y, height);
+}
+
+// Copy all dirty regions from the back buffer to the framebuffer.
+// With page flipping they go to the hidden page, together with the
+// regions it missed while the other page was the target, and that page
+// is then shown. The copy never touches the page on screen, so it does
+// not tear; the display picks up the new offset with its next frame.
+void graphics_present() {
+    rect_t presented[MAX_DIRTY_RECTS];
+    int presented_count = dirty_count;
+    
+    if (page_flip) {
+        if (dirty_count == 0) {
+            return;
+        }
+        for (int i = 0; i < dirty_count; i++) {
+            presented[i] = dirty_rects[i];
+        }
+        for (int i = 0; i < missed_count; i++) {
+            graphics_mark_dirty(missed_rects[i].x, missed_rects[i].y,
+                                missed_rects[i].width, missed_rects[i].height);
+        }
+        framebuffer = pages[back_page];
+    }
+    
+    for (int i = 0; i < dirty_count; i++) {
+        rect_t* r = &dirty_rects[i];
+        if (rect_area(r) >= PARALLEL_MIN_PIXELS) {
+            smp_run(present_band, r);
+        } else {
+            present_rows(r, r->y, r->height);
+        }
+    }
+    dirty_count = 0;
+    
+    if (page_flip) {
+        dispi_set_y_offset(back_page * SCREEN_HEIGHT);
+        back_page ^= 1;
+        
+        // The page now hidden is behind by this present
+        for (int i = 0; i < presented_count; i++) {
+            missed_rects[i] = presented[i];
+        }
+        missed_count = presented_count;
+    }
+}
+
+// Store a pixel in the back buffer (bounds checked, no damage tracking)
+static inline void plot(int x, int y, unsigned int color_val) {
+    if (x < 0 || x >= SCREEN_WIDTH || y < 0 || y >= SCREEN_HEIGHT) {
+        return;
+    }
+    backbuffer[y * SCREEN_WIDTH + x] = color_val;
+}
+
+// Allocate a screen-sized surface in RAM
+static unsigned int* graphics_alloc_surface(unsigned int fallback) {
+    unsigned int addr = pmm_alloc_pages(SURFACE_FRAMES);
+    return (unsigned int*)(addr ? addr : fallback);
+}
+
 // Initialize graphics
 void graphics_init() {
-    // Get framebuffer address from bootloader (stored at 0x5000)
-    framebuffer = (unsigned int*)(*((unsigned int*)0x5000));
+    // Get framebuffer address from the bootloader's boot info
+    const boot_info_t* info = boot_info();
+    framebuffer = info ? (unsigned int*)info->framebuffer : 0;
+    dirty_count = 0;
+    
+    // Present into the hidden half of a double-height virtual screen when
+    // the adapter has one; otherwise straight into the LFB
+    page_flip = dispi_detect() &&
+                dispi_setup_pages(SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_BPP, 2);
+    pages[0] = framebuffer;
+    pages[1] = framebuffer + SCREEN_WIDTH * SCREEN_HEIGHT;
+    back_page = 1;
+    missed_count = 0;
+    backbuffer = graphics_alloc_surface(BACKBUFFER_ADDR);
+    wallpaper = graphics_alloc_surface(WALLPAPER_ADDR);
+    
+    // Stores to the LFB are combined into bursts instead of going out
+    // one uncached dword at a time
+    paging_map_wc((unsigned int)framebuffer,
+                  SCREEN_WIDTH * SCREEN_HEIGHT * 4 * (page_flip ? 2 : 1));
+    
+    // Pick SSE2 or scalar blending kernels and fill paths
+    blend_init();
+    stream_fill = cpu_has(CPU_FEATURE_SSE2) && cpu_enable_sse();
+    
+    // Render the wallpaper surface once
+    wallpaper_ready = 0;
+    graphics_generate_wallpaper();
     
     // Clear screen to black
     graphics_clear(COLOR_BLACK);
+    graphics_present();
 }
 
-// Get framebuffer pointer
+// Get framebuffer pointer (the page on screen)
 unsigned int* graphics_get_framebuffer() {
     return framebuffer;
 }
 
+// Get back buffer pointer (callers writing to it must call graphics_mark_dirty)
+unsigned int* graphics_get_backbuffer() {
+    return backbuffer;
+}
+
+// Restrict fills, lines, text and background restores to a rectangle
+void graphics_set_clip(int x, int y, int width, int height) {
+    if (!clip_rect_to(&x, &y, &width, &height, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT)) {
+        width = 0;
+        height = 0;
+    }
+    clip_x0 = x;
+    clip_y0 = y;
+    clip_x1 = x + width;
+    clip_y1 = y + height;
+}
+
+// Clip to the whole screen again
+void graphics_reset_clip() {
+    clip_x0 = 0;
+    clip_y0 = 0;
+    clip_x1 = SCREEN_WIDTH;
+    clip_y1 = SCREEN_HEIGHT;
+}
+
+// smp_run() part: fill one band of the back buffer
+static void clear_band(void* arg, int index, int count) {
+    int y, height;
+    band_rows(0, SCREEN_HEIGHT, index, count, &y, &height);
+    fill_span(backbuffer + y * SCREEN_WIDTH, *(unsigned int*)arg, height * SCREEN_WIDTH);
+}
+
 // Clear screen with color
 void graphics_clear(color_t color) {
-    unsigned int color_val = (color.a << 24) | (color.r << 16) | (color.g << 8) | color.b;
-    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
-        framebuffer[i] = color_val;
-    }
+    unsigned int value = pack_color(color);
+    smp_run(clear_band, &value);
+    graphics_mark_dirty(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
 }
 
 // Put pixel at x, y
@@ -127,9 +493,8 @@ void graphics_putpixel(int x, int y, color_t color) {
         return;
     }
     
-    int offset = y * SCREEN_WIDTH + x;
-    unsigned int color_val = (color.a << 24) | (color.r << 16) | (color.g << 8) | color.b;
-    framebuffer[offset] = color_val;
+    backbuffer[y * SCREEN_WIDTH + x] = pack_color(color);
+    graphics_mark_dirty(x, y, 1, 1);
 }
 
 // Get pixel at x, y
@@ -138,77 +503,298 @@ color_t graphics_getpixel(int x, int y) {
         return COLOR_BLACK;
     }
     
-    int offset = y * SCREEN_WIDTH + x;
-    unsigned int pixel = framebuffer[offset];
+    return unpack_color(backbuffer[y * SCREEN_WIDTH + x]);
+}
+
+// Fill rectangle (blended when color.a < 255)
+void graphics_fill_rect(int x, int y, int width, int height, color_t color) {
+    // Clip once instead of per pixel
+    if (!clip_rect(&x, &y, &width, &height)) {
+        return;
+    }
     
-    color_t color;
-    color.b = pixel & 0xFF;
-    color.g = (pixel >> 8) & 0xFF;
-    color.r = (pixel >> 16) & 0xFF;
-    color.a = (pixel >> 24) & 0xFF;
+    unsigned int* row = backbuffer + y * SCREEN_WIDTH + x;
     
-    return color;
+    if (color.a == 255) {
+        unsigned int color_val = pack_color(color);
+        if (width == SCREEN_WIDTH) {
+            // Full-width band is one contiguous span
+            fill_span(row, color_val, width * height);
+        } else {
+            for (int dy = 0; dy < height; dy++) {
+                fill_span(row, color_val, width);
+                row += SCREEN_WIDTH;
+            }
+        }
+    } else {
+        blend_rect(row, SCREEN_WIDTH, width, height, blend_premultiply(color));
+    }
+    graphics_mark_dirty(x, y, width, height);
 }
 
-// Fill rectangle
-void graphics_fill_rect(int x, int y, int width, int height, color_t color) {
-    for (int dy = 0; dy < height; dy++) {
-        for (int dx = 0; dx < width; dx++) {
-            graphics_putpixel(x + dx, y + dy, color);
+// Draw horizontal line
+void graphics_hline(int x, int y, int width, color_t color) {
+    graphics_fill_rect(x, y, width, 1, color);
+}
+
+// Draw vertical line (one store per row, no string op setup)
+void graphics_vline(int x, int y, int height, color_t color) {
+    int width = 1;
+    if (!clip_rect(&x, &y, &width, &height)) {
+        return;
+    }
+    
+    unsigned int* p = backbuffer + y * SCREEN_WIDTH + x;
+    
+    if (color.a == 255) {
+        unsigned int color_val = pack_color(color);
+        for (int dy = 0; dy < height; dy++) {
+            *p = color_val;
+            p += SCREEN_WIDTH;
         }
+    } else {
+        blend_rect(p, SCREEN_WIDTH, 1, height, blend_premultiply(color));
     }
+    graphics_mark_dirty(x, y, 1, height);
 }
 
 // Draw rectangle outline
 void graphics_draw_rect(int x, int y, int width, int height, color_t color) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    
     // Top and bottom
-    for (int dx = 0; dx < width; dx++) {
-        graphics_putpixel(x + dx, y, color);
-        graphics_putpixel(x + dx, y + height - 1, color);
+    graphics_hline(x, y, width, color);
+    if (height > 1) {
+        graphics_hline(x, y + height - 1, width, color);
     }
     
-    // Left and right
-    for (int dy = 0; dy < height; dy++) {
-        graphics_putpixel(x, y + dy, color);
-        graphics_putpixel(x + width - 1, y + dy, color);
+    // Left and right (corners already drawn)
+    if (height > 2) {
+        graphics_vline(x, y + 1, height - 2, color);
+        if (width > 1) {
+            graphics_vline(x + width - 1, y + 1, height - 2, color);
+        }
     }
 }
 
-// Draw line (Bresenham's algorithm)
-void graphics_draw_line(int x1, int y1, int x2, int y2, color_t color) {
+// Line engine.
+// A Bresenham line with major axis u and minor axis v plots pixel k
+// (0 <= k <= du) at u1 + su*k, v1 + sv*m(k), where m(k) is the number of
+// minor steps taken so far. m(k) has a closed form, so a line is clipped by
+// solving for its visible k range up front and starting the walk there
+// with the error term the full walk would have had: a clipped line plots
+// exactly the pixels of the unclipped one, in time proportional to the
+// visible part.
+
+// Keeps the error term products within 32 bits
+#define LINE_COORD_LIMIT 16384
+
+typedef struct {
+    int u1, v1;     // Start on the major/minor axis
+    int du, dv;     // Absolute deltas (du >= dv)
+    int su, sv;     // Step directions
+    int e0;         // Initial error term
+    int x_major;    // u is x
+} line_t;
+
+// Minor steps taken after k major steps
+static inline int line_minor_steps(const line_t* l, int k) {
+    int t = k * l->dv - l->e0;
+    return t <= 0 ? 0 : (t + l->du - 1) / l->du;
+}
+
+// First k at which m(k) reaches m (m >= 1, dv > 0)
+static inline int line_first_step(const line_t* l, int m) {
+    return ((m - 1) * l->du + l->e0) / l->dv + 1;
+}
+
+// Distance between two coordinates (does not overflow)
+static inline unsigned int line_span(int a, int b) {
+    return a < b ? (unsigned int)b - (unsigned int)a : (unsigned int)a - (unsigned int)b;
+}
+
+// Minor axis coordinate where the line from (a, b) to (a_end, b_end)
+// reaches major coordinate target, rounded to nearest. target lies
+// between a and a_end, so the product fits 64 bits and the quotient 32.
+static int line_intercept(int a, int b, int a_end, int b_end, int target) {
+    unsigned int da = line_span(a, a_end);
+    unsigned long long n = (unsigned long long)line_span(a, target) * line_span(b, b_end) + da / 2;
+    unsigned int step = div64_32(n, da);
+    return b_end < b ? (int)((unsigned int)b - step) : (int)((unsigned int)b + step);
+}
+
+// Move an endpoint beyond LINE_COORD_LIMIT along the line onto the
+// limit box, one edge per pass, so the engine below can work in 32 bits.
+// The moved end is off screen and within half a pixel of the line.
+// Returns 0 if the line misses the box.
+static int line_pull_in(int* x, int* y, int x_other, int y_other) {
+    for (int pass = 0; pass < 4; pass++) {
+        if (*x < -LINE_COORD_LIMIT || *x > LINE_COORD_LIMIT) {
+            int limit = *x < 0 ? -LINE_COORD_LIMIT : LINE_COORD_LIMIT;
+            if (limit < 0 ? x_other < limit : x_other > limit) {
+                return 0;
+            }
+            *y = line_intercept(*x, *y, x_other, y_other, limit);
+            *x = limit;
+        } else if (*y < -LINE_COORD_LIMIT || *y > LINE_COORD_LIMIT) {
+            int limit = *y < 0 ? -LINE_COORD_LIMIT : LINE_COORD_LIMIT;
+            if (limit < 0 ? y_other < limit : y_other > limit) {
+                return 0;
+            }
+            *x = line_intercept(*y, *x, y_other, x_other, limit);
+            *y = limit;
+        } else {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Store a run of len pixels along the major axis starting at (u, v)
+static void line_run(const line_t* l, int u, int v, int len, unsigned int value, int opaque) {
+    int start = l->su > 0 ? u : u - len + 1;
+    
+    if (l->x_major) {
+        unsigned int* p = backbuffer + v * SCREEN_WIDTH + start;
+        if (opaque) {
+            fill_dwords(p, value, len);
+        } else {
+            blend_row(p, value, len);
+        }
+    } else {
+        unsigned int* p = backbuffer + start * SCREEN_WIDTH + v;
+        if (opaque) {
+            for (int i = 0; i < len; i++) {
+                *p = value;
+                p += SCREEN_WIDTH;
+            }
+        } else {
+            blend_rect(p, SCREEN_WIDTH, 1, len, value);
+        }
+    }
+}
+
+// Clip and draw one line. value is the packed color (opaque) or the
+// premultiplied color (translucent). skip_first drops pixel 0 so polyline
+// joints are not drawn (or blended) twice.
+static void line_draw(int x1, int y1, int x2, int y2, unsigned int value, int opaque,
+                      int skip_first) {
+    if (!line_pull_in(&x1, &y1, x2, y2) || !line_pull_in(&x2, &y2, x1, y1)) {
+        return;
+    }
+    
     int dx = x2 - x1;
     int dy = y2 - y1;
     int dx_abs = dx < 0 ? -dx : dx;
     int dy_abs = dy < 0 ? -dy : dy;
-    int sx = dx < 0 ? -1 : 1;
-    int sy = dy < 0 ? -1 : 1;
+    int umin, umax, vmin, vmax;
+    line_t l;
     
     if (dx_abs > dy_abs) {
-        int err = dx_abs / 2;
-        int y = y1;
-        for (int x = x1; x != x2; x += sx) {
-            graphics_putpixel(x, y, color);
-            err -= dy_abs;
-            if (err < 0) {
-                y += sy;
-                err += dx_abs;
-            }
-        }
+        l.u1 = x1; l.v1 = y1; l.du = dx_abs; l.dv = dy_abs;
+        l.su = dx < 0 ? -1 : 1; l.sv = dy < 0 ? -1 : 1;
+        l.x_major = 1;
+        umin = clip_x0; umax = clip_x1 - 1; vmin = clip_y0; vmax = clip_y1 - 1;
     } else {
-        int err = dy_abs / 2;
-        int x = x1;
-        for (int y = y1; y != y2; y += sy) {
-            graphics_putpixel(x, y, color);
-            err -= dx_abs;
-            if (err < 0) {
-                x += sx;
-                err += dy_abs;
-            }
+        l.u1 = y1; l.v1 = x1; l.du = dy_abs; l.dv = dx_abs;
+        l.su = dy < 0 ? -1 : 1; l.sv = dx < 0 ? -1 : 1;
+        l.x_major = 0;
+        umin = clip_y0; umax = clip_y1 - 1; vmin = clip_x0; vmax = clip_x1 - 1;
+    }
+    l.e0 = l.du / 2;
+    
+    // Visible k range from the major axis
+    int k0 = skip_first ? 1 : 0;
+    int k1 = l.du;
+    int lo = l.su > 0 ? umin - l.u1 : l.u1 - umax;
+    int hi = l.su > 0 ? umax - l.u1 : l.u1 - umin;
+    if (lo > k0) k0 = lo;
+    if (hi < k1) k1 = hi;
+    
+    // ... narrowed by the minor axis (m(k) is monotonic)
+    int mlo = l.sv > 0 ? vmin - l.v1 : l.v1 - vmax;
+    int mhi = l.sv > 0 ? vmax - l.v1 : l.v1 - vmin;
+    if (mhi < 0 || mlo > l.dv) {
+        return;
+    }
+    if (mlo > 0) {
+        int k = line_first_step(&l, mlo);
+        if (k > k0) k0 = k;
+    }
+    if (mhi < l.dv) {
+        int k = line_first_step(&l, mhi + 1) - 1;
+        if (k < k1) k1 = k;
+    }
+    if (k0 > k1) {
+        return;
+    }
+    
+    // Enter the walk at k0
+    int m = line_minor_steps(&l, k0);
+    int err = l.e0 - k0 * l.dv + m * l.du;
+    int u = l.u1 + l.su * k0;
+    int v = l.v1 + l.sv * m;
+    int u_first = u, v_first = v;
+    
+    // Run-length stepping: every pixel of a run shares v. With dv == 0
+    // (horizontal/vertical lines) the whole visible line is a single span.
+    int k = k0;
+    while (k <= k1) {
+        int run = l.dv ? err / l.dv + 1 : k1 - k + 1;
+        if (run > k1 - k + 1) run = k1 - k + 1;
+        
+        line_run(&l, u, v, run, value, opaque);
+        
+        k += run;
+        u += l.su * run;
+        err -= run * l.dv;
+        if (err < 0 && k <= k1) {
+            v += l.sv;
+            err += l.du;
         }
     }
+    
+    // Damage: bounding box of the visible part
+    int u_last = u - l.su;
+    int v_last = v;
+    int ua = u_first < u_last ? u_first : u_last;
+    int va = v_first < v_last ? v_first : v_last;
+    int ulen = (u_first > u_last ? u_first - u_last : u_last - u_first) + 1;
+    int vlen = (v_first > v_last ? v_first - v_last : v_last - v_first) + 1;
+    if (l.x_major) {
+        graphics_mark_dirty(ua, va, ulen, vlen);
+    } else {
+        graphics_mark_dirty(va, ua, vlen, ulen);
+    }
+}
+
+// Draw line (clipped Bresenham, endpoints included)
+void graphics_draw_line(int x1, int y1, int x2, int y2, color_t color) {
+    if (color.a == 255) {
+        line_draw(x1, y1, x2, y2, pack_color(color), 1, 0);
+    } else {
+        line_draw(x1, y1, x2, y2, blend_premultiply(color), 0, 0);
+    }
 }
 
-// Alpha blending function
+// Draw connected line segments through count points
+void graphics_draw_polyline(const point_t* points, int count, color_t color) {
+    int opaque = color.a == 255;
+    unsigned int value = opaque ? pack_color(color) : blend_premultiply(color);
+    
+    if (count == 1) {
+        line_draw(points[0].x, points[0].y, points[0].x, points[0].y, value, opaque, 0);
+        return;
+    }
+    for (int i = 1; i < count; i++) {
+        line_draw(points[i - 1].x, points[i - 1].y, points[i].x, points[i].y,
+                  value, opaque, i > 1);
+    }
+}
+
+// Alpha blending function (reference for the span kernels in blend.c)
 color_t graphics_blend(color_t fg, color_t bg) {
     if (fg.a == 255) return fg;
     if (fg.a == 0) return bg;
@@ -217,71 +803,251 @@ color_t graphics_blend(color_t fg, color_t bg) {
     int alpha = fg.a;
     int inv_alpha = 255 - alpha;
     
-    result.r = (fg.r * alpha + bg.r * inv_alpha) / 255;
-    result.g = (fg.g * alpha + bg.g * inv_alpha) / 255;
-    result.b = (fg.b * alpha + bg.b * inv_alpha) / 255;
+    // Premultiplied form with exact rounded division by 255
+    result.r = blend_mul255(fg.r, alpha) + blend_mul255(bg.r, inv_alpha);
+    result.g = blend_mul255(fg.g, alpha) + blend_mul255(bg.g, inv_alpha);
+    result.b = blend_mul255(fg.b, alpha) + blend_mul255(bg.b, inv_alpha);
     result.a = 255;
     
     return result;
 }
 
-// Draw a character at x, y using bitmap font
-void graphics_draw_char(int x, int y, char c, color_t fg, color_t bg) {
-    if (c < 0 || c >= 128) c = '?';
+// Glyph row cache.
+// An 8x8 glyph row is just an 8-bit pattern, so for a given (fg, bg) pair
+// every row of every glyph is one of 256 patterns. Each slot expands those
+// patterns lazily into 8 ready-to-store pixels; a glyph row is then a
+// straight 8-dword copy instead of 8 bit tests and packs.
+#define GLYPH_CACHE_SLOTS 8
+
+// How a (fg, bg) pair is rendered
+#define GLYPH_MODE_OPAQUE 0   // Every pixel stored (fg and bg opaque)
+#define GLYPH_MODE_MASKED 1   // Set pixels stored as fg, unset pixels skipped
+#define GLYPH_MODE_BLEND  2   // Set pixels blended, unset pixels stored or skipped
+
+typedef struct {
+    unsigned int fg;            // Packed key
+    unsigned int bg;
+    unsigned int fg_pm;         // Premultiplied fg for blending
+    unsigned int age;           // LRU stamp
+    int mode;
+    unsigned int valid[8];      // One bit per expanded pattern
+    unsigned int rows[256][8];  // Expanded patterns
+} glyph_slot_t;
+
+static glyph_slot_t glyph_cache[GLYPH_CACHE_SLOTS];
+static int glyph_cache_used = 0;
+static int glyph_last_slot = 0;
+static unsigned int glyph_clock = 0;
+
+// Find or claim the cache slot for a color pair
+static glyph_slot_t* glyph_cache_lookup(color_t fg, color_t bg) {
+    unsigned int fg_val = pack_color(fg);
+    unsigned int bg_val = pack_color(bg);
+    glyph_slot_t* slot = &glyph_cache[glyph_last_slot];
+    
+    glyph_clock++;
+    if (glyph_cache_used > 0 && slot->fg == fg_val && slot->bg == bg_val) {
+        slot->age = glyph_clock;
+        return slot;
+    }
+    
+    int victim = 0;
+    for (int i = 0; i < glyph_cache_used; i++) {
+        slot = &glyph_cache[i];
+        if (slot->fg == fg_val && slot->bg == bg_val) {
+            slot->age = glyph_clock;
+            glyph_last_slot = i;
+            return slot;
+        }
+        if (slot->age < glyph_cache[victim].age) {
+            victim = i;
+        }
+    }
     
-    for (int row = 0; row < 8; row++) {
-        unsigned char line = font_8x8[(int)c][row];
+    // Miss: take a free slot or evict the least recently used one
+    if (glyph_cache_used < GLYPH_CACHE_SLOTS) {
+        victim = glyph_cache_used++;
+    }
+    slot = &glyph_cache[victim];
+    slot->fg = fg_val;
+    slot->bg = bg_val;
+    slot->fg_pm = blend_premultiply(fg);
+    slot->age = glyph_clock;
+    for (int i = 0; i < 8; i++) {
+        slot->valid[i] = 0;
+    }
+    
+    // Same rules as the per-pixel renderer: fg is blended unless it is
+    // opaque or the background is fully transparent; bg is only drawn
+    // when opaque
+    if (fg.a < 255 && bg.a > 0) {
+        slot->mode = GLYPH_MODE_BLEND;
+    } else if (bg.a == 255) {
+        slot->mode = GLYPH_MODE_OPAQUE;
+    } else {
+        slot->mode = GLYPH_MODE_MASKED;
+    }
+    
+    glyph_last_slot = victim;
+    return slot;
+}
+
+// Get the expanded pixels for one row pattern
+static inline const unsigned int* glyph_row(glyph_slot_t* slot, unsigned char bits) {
+    unsigned int* row = slot->rows[bits];
+    unsigned int word = bits >> 5;
+    unsigned int mask = 1u << (bits & 31);
+    
+    if (!(slot->valid[word] & mask)) {
         for (int col = 0; col < 8; col++) {
-            if (line & (1 << (7 - col))) {
-                // Draw foreground
-                if (bg.a > 0) {
-                    color_t blended = graphics_blend(fg, graphics_getpixel(x + col, y + row));
-                    graphics_putpixel(x + col, y + row, blended);
-                } else {
-                    graphics_putpixel(x + col, y + row, fg);
-                }
-            } else if (bg.a == 255) {
-                // Draw background (only if opaque)
-                graphics_putpixel(x + col, y + row, bg);
+            row[col] = (bits & (1 << (7 - col))) ? slot->fg : slot->bg;
+        }
+        slot->valid[word] |= mask;
+    }
+    return row;
+}
+
+// Draw columns [col0, col1) of one glyph row
+static inline void glyph_store_row(unsigned int* dst, glyph_slot_t* slot, unsigned char bits,
+                                   int col0, int col1) {
+    if (slot->mode == GLYPH_MODE_OPAQUE) {
+        const unsigned int* src = glyph_row(slot, bits);
+        if (col0 == 0 && col1 == 8) {
+            dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = src[3];
+            dst[4] = src[4]; dst[5] = src[5]; dst[6] = src[6]; dst[7] = src[7];
+        } else {
+            for (int col = col0; col < col1; col++) {
+                dst[col] = src[col];
             }
         }
+        return;
     }
+    
+    if (bits == 0) {
+        // Nothing but (non-opaque) background in this row
+        if (slot->mode == GLYPH_MODE_BLEND && (slot->bg >> 24) == 255) {
+            for (int col = col0; col < col1; col++) {
+                dst[col] = slot->bg;
+            }
+        }
+        return;
+    }
+    
+    if (slot->mode == GLYPH_MODE_MASKED) {
+        for (int col = col0; col < col1; col++) {
+            if (bits & (1 << (7 - col))) {
+                dst[col] = slot->fg;
+            }
+        }
+        return;
+    }
+    
+    // GLYPH_MODE_BLEND
+    blend_mask(dst + col0, slot->fg_pm, (bits << col0) & 0xFF, col1 - col0);
+    if ((slot->bg >> 24) == 255) {
+        for (int col = col0; col < col1; col++) {
+            if (!(bits & (1 << (7 - col)))) {
+                dst[col] = slot->bg;
+            }
+        }
+    }
+}
+
+// Draw a run of characters on one line.
+// The run is clipped once up front; the inner loop walks one scanline of
+// the whole run at a time so back buffer stores stay sequential.
+void graphics_draw_text(int x, int y, const char* str, int len, color_t fg, color_t bg) {
+    if (len <= 0) {
+        return;
+    }
+    
+    // Vertical clip
+    int row0 = y < clip_y0 ? clip_y0 - y : 0;
+    int row1 = y + 8 > clip_y1 ? clip_y1 - y : 8;
+    if (row0 >= row1 || x >= clip_x1) {
+        return;
+    }
+    
+    // Horizontal clip: visible characters [first, last) and the pixel
+    // columns of the two edge glyphs
+    int first = x < clip_x0 ? (clip_x0 - x) / 8 : 0;
+    int last = (clip_x1 - x + 7) / 8;
+    if (last > len) last = len;
+    if (first >= last) {
+        return;
+    }
+    int lead_col = x < clip_x0 ? (clip_x0 - x) % 8 : 0;
+    int tail_col = x + last * 8 > clip_x1 ? 8 - (x + last * 8 - clip_x1) : 8;
+    
+    glyph_slot_t* slot = glyph_cache_lookup(fg, bg);
+    
+    for (int row = row0; row < row1; row++) {
+        unsigned int* line = backbuffer + (y + row) * SCREEN_WIDTH + x;
+        for (int i = first; i < last; i++) {
+            int c = (unsigned char)str[i];
+            if (c >= 128) c = '?';
+            int col0 = i == first ? lead_col : 0;
+            int col1 = i == last - 1 ? tail_col : 8;
+            glyph_store_row(line + i * 8, slot, font_8x8[c][row], col0, col1);
+        }
+    }
+    
+    graphics_mark_dirty(x + first * 8 + lead_col, y + row0,
+                        (last - first) * 8 - lead_col - (8 - tail_col), row1 - row0);
+}
+
+// Draw a character at x, y using bitmap font
+void graphics_draw_char(int x, int y, char c, color_t fg, color_t bg) {
+    graphics_draw_text(x, y, &c, 1, fg, bg);
 }
 
 // Draw a string at x, y
 void graphics_draw_string(int x, int y, const char* str, color_t fg, color_t bg) {
-    int current_x = x;
+    int start = 0;
     int i = 0;
     
-    while (str[i] != '\0') {
-        if (str[i] == '\n') {
-            current_x = x;
+    // Each line is drawn as a single run
+    while (1) {
+        if (str[i] == '\n' || str[i] == '\0') {
+            graphics_draw_text(x, y, str + start, i - start, fg, bg);
+            if (str[i] == '\0') {
+                break;
+            }
             y += 10;
-        } else {
-            graphics_draw_char(current_x, y, str[i], fg, bg);
-            current_x += 8;
+            start = i + 1;
         }
         i++;
     }
 }
 
-// Simple gradient wallpaper generator
-void graphics_load_wallpaper() {
-    // Create a beautiful gradient wallpaper
-    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+// The x term of the wallpaper gradient is the same for every row, so it
+// is built once as a per-column pixel offset (no channel can carry into
+// the next)
+static unsigned int wallpaper_columns[SCREEN_WIDTH];
+
+// Render wallpaper rows [y0, y1): gradient, then the circles' spans
+static void wallpaper_rows(int y0, int y1) {
+    // The y term (y * k) / SCREEN_HEIGHT is stepped per row in fixed point:
+    // quotient plus remainder, exact without a division per row
+    unsigned int r_q = y0 * 100 / SCREEN_HEIGHT, r_rem = y0 * 100 % SCREEN_HEIGHT;
+    unsigned int g_q = y0 * 150 / SCREEN_HEIGHT, g_rem = y0 * 150 % SCREEN_HEIGHT;
+    unsigned int b_q = y0 * 155 / SCREEN_HEIGHT, b_rem = y0 * 155 % SCREEN_HEIGHT;
+    
+    for (int y = y0; y < y1; y++) {
+        unsigned int* row = wallpaper + y * SCREEN_WIDTH;
+        color_t base = {100 + b_q, 30 + g_q, 20 + r_q, 255};
+        unsigned int base_val = pack_color(base);
+        
         for (int x = 0; x < SCREEN_WIDTH; x++) {
-            // Create a gradient from dark blue/purple to lighter blue
-            unsigned char r = (y * 100) / SCREEN_HEIGHT + 20;
-            unsigned char g = (y * 150) / SCREEN_HEIGHT + 30;
-            unsigned char b = 100 + (y * 155) / SCREEN_HEIGHT;
-            
-            // Add some variation based on x position
-            r += (x * 20) / SCREEN_WIDTH;
-            g += (x * 30) / SCREEN_WIDTH;
-            
-            color_t color = {b, g, r, 255};
-            graphics_putpixel(x, y, color);
+            row[x] = base_val + wallpaper_columns[x];
         }
+        
+        r_rem += 100;
+        while (r_rem >= SCREEN_HEIGHT) { r_rem -= SCREEN_HEIGHT; r_q++; }
+        g_rem += 150;
+        while (g_rem >= SCREEN_HEIGHT) { g_rem -= SCREEN_HEIGHT; g_q++; }
+        b_rem += 155;
+        while (b_rem >= SCREEN_HEIGHT) { b_rem -= SCREEN_HEIGHT; b_q++; }
     }
     
     // Draw some decorative circles for effect
@@ -291,19 +1057,137 @@ void graphics_load_wallpaper() {
         int radius = 80 + (i * 30);
         
         color_t circle_color = {150, 100, 200, 40}; // Semi-transparent purple
+        unsigned int circle_pm = blend_premultiply(circle_color);
         
+        // One blended span per row: half width is the largest x with
+        // x*x + y*y <= radius*radius, tracked incrementally
+        int half = 0;
         for (int y = -radius; y <= radius; y++) {
-            for (int x = -radius; x <= radius; x++) {
-                if (x*x + y*y <= radius*radius) {
-                    int px = cx + x;
-                    int py = cy + y;
-                    if (px >= 0 && px < SCREEN_WIDTH && py >= 0 && py < SCREEN_HEIGHT) {
-                        color_t bg = graphics_getpixel(px, py);
-                        color_t blended = graphics_blend(circle_color, bg);
-                        graphics_putpixel(px, py, blended);
-                    }
-                }
+            while ((half + 1) * (half + 1) + y * y <= radius * radius) half++;
+            while (half * half + y * y > radius * radius) half--;
+            
+            int py = cy + y;
+            if (py < y0 || py >= y1) {
+                continue;
+            }
+            int x0 = cx - half < 0 ? 0 : cx - half;
+            int x1 = cx + half >= SCREEN_WIDTH ? SCREEN_WIDTH - 1 : cx + half;
+            if (x0 <= x1) {
+                blend_row(wallpaper + py * SCREEN_WIDTH + x0, circle_pm, x1 - x0 + 1);
             }
         }
     }
 }
+
+// smp_run() part: one band of the wallpaper
+static void wallpaper_band(void* arg, int index, int count) {
+    int y, height;
+    band_rows(0, SCREEN_HEIGHT, index, count, &y, &height);
+    wallpaper_rows(y, y + height);
+}
+
+// Simple gradient wallpaper generator (renders into the wallpaper surface)
+void graphics_generate_wallpaper() {
+    // Create a beautiful gradient wallpaper: a dark blue/purple to lighter
+    // blue vertical gradient plus some variation based on x position
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+        unsigned int r = (x * 20) / SCREEN_WIDTH;
+        unsigned int g = (x * 30) / SCREEN_WIDTH;
+        wallpaper_columns[x] = (r << 16) | (g << 8);
+    }
+    
+    // Bands are independent: each row depends only on its own y
+    smp_run(wallpaper_band, 0);
+    wallpaper_ready = 1;
+    tinted_ready = 0;
+}
+
+// Copy a region of the cached wallpaper back into the back buffer,
+// within the current clip rectangle
+void graphics_restore_background(int x, int y, int width, int height) {
+    if (!wallpaper_ready) {
+        graphics_generate_wallpaper();
+    }
+    if (!clip_rect(&x, &y, &width, &height)) {
+        return;
+    }
+    
+    int offset = y * SCREEN_WIDTH + x;
+    if (width == SCREEN_WIDTH) {
+        copy_dwords(backbuffer + offset, wallpaper + offset, width * height);
+    } else {
+        for (int row = 0; row < height; row++) {
+            copy_dwords(backbuffer + offset, wallpaper + offset, width);
+            offset += SCREEN_WIDTH;
+        }
+    }
+    graphics_mark_dirty(x, y, width, height);
+}
+
+// smp_run() part: one band of the tinted wallpaper
+static void tinted_band(void* arg, int index, int count) {
+    int y, height;
+    band_rows(0, SCREEN_HEIGHT, index, count, &y, &height);
+    int offset = y * SCREEN_WIDTH;
+    copy_dwords(tinted + offset, wallpaper + offset, height * SCREEN_WIDTH);
+    blend_row(tinted + offset, tinted_value, height * SCREEN_WIDTH);
+}
+
+// Paint a region with the wallpaper under a translucent color: the same
+// pixels as graphics_restore_background() followed by graphics_fill_rect()
+// with that color, in one copy. Both clip to the current clip rectangle,
+// so this does too.
+void graphics_restore_tinted(int x, int y, int width, int height, color_t color) {
+    unsigned int value = blend_premultiply(color);
+    
+    if (!wallpaper_ready) {
+        graphics_generate_wallpaper();
+    }
+    if (!clip_rect(&x, &y, &width, &height)) {
+        return;
+    }
+    if (!tinted_ready || value != tinted_value) {
+        if (!tinted) {
+            tinted = graphics_alloc_surface(TINTED_ADDR);
+        }
+        tinted_value = value;
+        smp_run(tinted_band, 0);
+        tinted_ready = 1;
+    }
+    
+    int offset = y * SCREEN_WIDTH + x;
+    for (int row = 0; row < height; row++) {
+        copy_dwords(backbuffer + offset, tinted + offset, width);
+        offset += SCREEN_WIDTH;
+    }
+    graphics_mark_dirty(x, y, width, height);
+}
+
+// Show the wallpaper on the whole screen
+void graphics_load_wallpaper() {
+    graphics_restore_background(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+}
+
+// Move the contents of a region up by dy pixels (forward copy, so the
+// overlap is safe); the vacated bottom strip keeps stale pixels for the
+// caller to repaint
+void graphics_scroll_rect(int x, int y, int width, int height, int dy) {
+    if (!clip_rect_to(&x, &y, &width, &height, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT)) {
+        return;
+    }
+    if (dy <= 0 || dy >= height) {
+        return;
+    }
+    
+    int offset = y * SCREEN_WIDTH + x;
+    int rows = height - dy;
+    if (width == SCREEN_WIDTH) {
+        copy_dwords(backbuffer + offset, backbuffer + offset + dy * SCREEN_WIDTH, width * rows);
+    } else {
+        for (int row = 0; row < rows; row++) {
+            copy_dwords(backbuffer + offset, backbuffer + offset + dy * SCREEN_WIDTH, width);
+            offset += SCREEN_WIDTH;
+        }
+    }
+    graphics_mark_dirty(x, y, width, rows);
+}
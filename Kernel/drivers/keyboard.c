@@ -1,5 +1,10 @@
 #include "../../Lib/include/keyboard.h"
 #include "../../Lib/include/screen.h"
+#include "../../Lib/include/thread.h"
+#include "../../Lib/include/cpu.h"
+#include "../../Lib/include/io.h"
+#include "../../Lib/include/softirq.h"
+#include "../../Lib/include/input.h"
 
 // Keyboard scancode to ASCII map (US layout)
 static unsigned char keyboard_map[128] = {
@@ -7,8 +12,8 @@ static unsigned char keyboard_map[128] = {
     '\t', 'q', 'w', 'e', 'r', 't', 'y', 'u', 'i', 'o', 'p', '[', ']', '\n',
     0, 'a', 's', 'd', 'f', 'g', 'h', 'j', 'k', 'l', ';', '\'', '`',
     0, '\\', 'z', 'x', 'c', 'v', 'b', 'n', 'm', ',', '.', '/', 0,
-    '*', 0, ' ', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    '-', 0, 0, 0, '+', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    '*', 0, ' ', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, KEY_PGUP,
+    '-', 0, 0, 0, '+', 0, 0, KEY_PGDN, 0, 0, 0, 0, 0, 0, 0, 0
 };
 
 // Shift key pressed map
@@ -17,15 +22,16 @@ static unsigned char keyboard_map_shift[128] = {
     '\t', 'Q', 'W', 'E', 'R', 'T', 'Y', 'U', 'I', 'O', 'P', '{', '}', '\n',
     0, 'A', 'S', 'D', 'F', 'G', 'H', 'J', 'K', 'L', ':', '"', '~',
     0, '|', 'Z', 'X', 'C', 'V', 'B', 'N', 'M', '<', '>', '?', 0,
-    '*', 0, ' ', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    '-', 0, 0, 0, '+', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+    '*', 0, ' ', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, KEY_PGUP,
+    '-', 0, 0, 0, '+', 0, 0, KEY_PGDN, 0, 0, 0, 0, 0, 0, 0, 0
 };
 
-// Keyboard buffer
-#define KEYBOARD_BUFFER_SIZE 256
-static char keyboard_buffer[KEYBOARD_BUFFER_SIZE];
-static int buffer_read = 0;
-static int buffer_write = 0;
+// Raw scancodes captured by the IRQ handler (producer) for the softirq
+// (consumer); only scancode, pressed and tsc are filled in
+static input_queue_t raw_queue;
+
+// Translated events for the reader
+static input_queue_t event_queue;
 
 // Keyboard state
 static int shift_pressed = 0;
@@ -33,48 +39,34 @@ static int ctrl_pressed = 0;
 static int alt_pressed = 0;
 static int caps_lock = 0;
 
+// TSC readable (timestamps are 0 without one)
+static int have_tsc = 0;
+
+// Threads blocked waiting for events
+static wait_queue_t key_waiters;
+
 // Optional key handler callback
 static key_handler_t key_callback = 0;
 
 // External function to register IRQ handler
 extern void irq_install_handler(int irq, void (*handler)(void*));
 
-// Add character to buffer
-static void keyboard_buffer_put(char c) {
-    int next = (buffer_write + 1) % KEYBOARD_BUFFER_SIZE;
-    if (next != buffer_read) {
-        keyboard_buffer[buffer_write] = c;
-        buffer_write = next;
-    }
-}
-
-// Get character from buffer
-static char keyboard_buffer_get() {
-    if (buffer_read == buffer_write) {
-        return 0;
-    }
-    char c = keyboard_buffer[buffer_read];
-    buffer_read = (buffer_read + 1) % KEYBOARD_BUFFER_SIZE;
-    return c;
-}
-
-// Check if buffer has data
-int keyboard_available() {
-    return buffer_read != buffer_write;
+// Current modifier bits
+static unsigned char keyboard_modifiers() {
+    unsigned char mods = 0;
+    if (shift_pressed) mods |= INPUT_MOD_SHIFT;
+    if (ctrl_pressed) mods |= INPUT_MOD_CTRL;
+    if (alt_pressed) mods |= INPUT_MOD_ALT;
+    if (caps_lock) mods |= INPUT_MOD_CAPS;
+    return mods;
 }
 
-// Keyboard interrupt handler
-static void keyboard_handler(void* regs) {
-    unsigned char scancode;
-    
-    // Read scancode from keyboard
-    __asm__ __volatile__("inb %1, %0" : "=a"(scancode) : "Nd"((unsigned short)0x60));
+// Update the modifier state and fill in keycode and modifiers
+static void keyboard_translate(input_event_t* event) {
+    unsigned char scancode = event->scancode;
     
-    // Check for key release (bit 7 set)
-    if (scancode & 0x80) {
+    if (!event->pressed) {
         // Key released
-        scancode &= 0x7F;
-        
         if (scancode == 0x2A || scancode == 0x36) {
             shift_pressed = 0;
         } else if (scancode == 0x1D) {
@@ -92,47 +84,127 @@ static void keyboard_handler(void* regs) {
             alt_pressed = 1;
         } else if (scancode == 0x3A) {
             caps_lock = !caps_lock;
-        } else {
-            // Convert scancode to ASCII
-            char c = 0;
-            
-            if (shift_pressed || caps_lock) {
-                c = keyboard_map_shift[scancode];
-            } else {
-                c = keyboard_map[scancode];
-            }
+        }
+    }
+    
+    // Convert scancode to ASCII (releases carry the key they release)
+    if (shift_pressed || caps_lock) {
+        event->keycode = keyboard_map_shift[scancode];
+    } else {
+        event->keycode = keyboard_map[scancode];
+    }
+    event->modifiers = keyboard_modifiers();
+}
+
+// Keyboard bottom half: translate everything the IRQ captured, with
+// interrupts enabled, then wake readers once for the whole batch
+static void keyboard_softirq(void* data) {
+    input_event_t batch[16];
+    int count, queued = 0;
+    
+    while ((count = input_queue_pop(&raw_queue, batch, 16)) > 0) {
+        for (int i = 0; i < count; i++) {
+            keyboard_translate(&batch[i]);
+            queued += input_queue_push(&event_queue, &batch[i]);
             
-            if (c != 0) {
-                keyboard_buffer_put(c);
-                
-                // Call callback if registered
-                if (key_callback) {
-                    key_callback(c);
-                }
+            // Call callback if registered
+            if (key_callback && batch[i].pressed && batch[i].keycode) {
+                key_callback(batch[i].keycode);
             }
         }
     }
+    if (queued) {
+        thread_wake_all(&key_waiters);
+    }
+}
+
+// Keyboard interrupt handler (top half): capture the scancode and its
+// arrival time, nothing else
+static void keyboard_handler(void* regs) {
+    input_event_t event;
+    unsigned char scancode = inb(0x60);
+    
+    event.tsc = have_tsc ? rdtsc() : 0;
+    event.scancode = scancode & 0x7F;
+    event.pressed = !(scancode & 0x80);
+    event.keycode = 0;
+    event.modifiers = 0;
+    input_queue_push(&raw_queue, &event);
+    softirq_raise(SOFTIRQ_KEYBOARD);
 }
 
 // Initialize keyboard driver
 void keyboard_init() {
-    buffer_read = 0;
-    buffer_write = 0;
     shift_pressed = 0;
     ctrl_pressed = 0;
     alt_pressed = 0;
     caps_lock = 0;
+    have_tsc = cpu_has(CPU_FEATURE_TSC);
+    input_queue_init(&raw_queue);
+    input_queue_init(&event_queue);
+    wait_queue_init(&key_waiters);
+    softirq_register(SOFTIRQ_KEYBOARD, keyboard_softirq, 0);
     
     // Register keyboard interrupt handler (IRQ1)
     irq_install_handler(1, (void (*)(void*))keyboard_handler);
 }
 
-// Get a character (blocking)
+// Check if input events are waiting
+int keyboard_available() {
+    return input_queue_count(&event_queue) != 0;
+}
+
+// Block until at least one event is waiting
+void keyboard_wait_event() {
+    if (sched_running()) {
+        // Check and sleep with interrupts off so the wakeup cannot
+        // slip in between
+        unsigned int flags = irq_save();
+        while (!keyboard_available()) {
+            thread_wait(&key_waiters);
+        }
+        irq_restore(flags);
+    } else {
+        // No softirqd yet: translate here
+        softirq_run();
+        while (!keyboard_available()) {
+            __asm__ __volatile__("hlt");
+            softirq_run();
+        }
+    }
+}
+
+// Take up to max pending events without blocking; returns the count
+int keyboard_read_events(input_event_t* out, int max) {
+    return input_queue_pop(&event_queue, out, max);
+}
+
+// Queue an event from another input source (the serial console) for the
+// same readers. Softirq handlers only: they run one at a time, which
+// keeps a single producer on the event queue.
+void keyboard_push_event(const input_event_t* event) {
+    if (input_queue_push(&event_queue, event)) {
+        thread_wake_all(&key_waiters);
+    }
+}
+
+// Get a character (blocking); skips releases and modifier keys
 char keyboard_getchar() {
-    while (!keyboard_available()) {
-        __asm__ __volatile__("hlt");
+    input_event_t event;
+    
+    while (1) {
+        keyboard_wait_event();
+        if (keyboard_read_events(&event, 1) && event.pressed && event.keycode) {
+            return event.keycode;
+        }
     }
-    return keyboard_buffer_get();
+}
+
+// Report queue counters
+void keyboard_get_stats(keyboard_stats_t* stats) {
+    stats->events = event_queue.pushed;
+    stats->dropped = event_queue.dropped;
+    stats->raw_dropped = raw_queue.dropped;
 }
 
 // Set key handler callback
@@ -1,6 +1,6 @@
 #include "../../Lib/include/screen.h"
 
-// Current cursor position
+// Current cursor position (relative to the visible screen)
 static unsigned int cursor_x = 0;
 static unsigned int cursor_y = 0;
 
@@ -8,16 +8,95 @@ static unsigned int cursor_y = 0;
 static unsigned char current_color = 0x0F;
 
 // VGA memory pointer
-static unsigned char* vga_memory = (unsigned char*)VGA_MEMORY;
+static unsigned short* vga_memory = (unsigned short*)VGA_MEMORY;
+
+// RAM copy of the whole text window. All writes go here; screen_flush()
+// copies the changed range to VGA memory, which is slow to write and
+// even slower to read.
+static unsigned short shadow[VGA_WINDOW_ROWS * VGA_WIDTH];
+static int dirty_start = 0;
+static int dirty_end = 0;
+
+// Window row shown at the top of the screen (CRTC start address)
+static int origin_row = 0;
+
+// Values last written to the CRTC
+static int hw_origin = -1;
+static int hw_cursor = -1;
+
+// Scroll by moving the display origin instead of copying the screen
+static int hardware_scroll = 1;
+
+// Output copy, 0 for none
+static screen_mirror_t mirror = 0;
+
+// Draw on the VGA text screen; off while a graphics mode owns the display
+static int display = 1;
 
 // Helper function to create color byte
 static unsigned char make_color(unsigned char fg, unsigned char bg) {
     return (bg << 4) | (fg & 0x0F);
 }
 
-// Helper function to get memory offset
+// Helper function to get the window cell of a screen position
 static int get_offset(int x, int y) {
-    return (y * VGA_WIDTH + x) * 2;
+    return (origin_row + y) * VGA_WIDTH + x;
+}
+
+// Write a CRTC register
+static void crtc_write(unsigned char reg, unsigned char value) {
+    __asm__ __volatile__("outb %0, %1" : : "a"(reg), "Nd"((unsigned short)0x3D4));
+    __asm__ __volatile__("outb %0, %1" : : "a"(value), "Nd"((unsigned short)0x3D5));
+}
+
+// Extend the range of shadow cells to copy on the next flush
+static void mark_dirty(int start, int end) {
+    if (dirty_start == dirty_end) {
+        dirty_start = start;
+        dirty_end = end;
+        return;
+    }
+    if (start < dirty_start) dirty_start = start;
+    if (end > dirty_end) dirty_end = end;
+}
+
+// Fill count shadow cells with blanks in the current color
+static void blank_cells(int start, int count) {
+    unsigned short blank = (current_color << 8) | ' ';
+    for (int i = 0; i < count; i++) {
+        shadow[start + i] = blank;
+    }
+    mark_dirty(start, start + count);
+}
+
+// Copy the changed cells to VGA memory and update the origin and cursor
+// registers. Runs once per print call, not per character.
+static void screen_flush() {
+    if (dirty_start != dirty_end) {
+        // Whole dwords: two cells per 32-bit store
+        int start = dirty_start & ~1;
+        int count = ((dirty_end + 1) & ~1) - start;
+        unsigned int* dst = (unsigned int*)(vga_memory + start);
+        const unsigned int* src = (const unsigned int*)(shadow + start);
+        count /= 2;
+        __asm__ __volatile__("rep movsl" : "+D"(dst), "+S"(src), "+c"(count) : : "memory");
+        dirty_start = dirty_end = 0;
+    }
+    
+    int origin = origin_row * VGA_WIDTH;
+    if (origin != hw_origin) {
+        crtc_write(0x0C, origin >> 8);
+        crtc_write(0x0D, origin & 0xFF);
+        hw_origin = origin;
+    }
+    
+    // The cursor location is a window address, not relative to the origin
+    int cursor = get_offset(cursor_x, cursor_y);
+    if (cursor != hw_cursor) {
+        crtc_write(0x0E, cursor >> 8);
+        crtc_write(0x0F, cursor & 0xFF);
+        hw_cursor = cursor;
+    }
 }
 
 // Initialize screen
@@ -25,43 +104,80 @@ void screen_init() {
     cursor_x = 0;
     cursor_y = 0;
     current_color = make_color(COLOR_WHITE, COLOR_BLACK);
+    hw_origin = -1;
+    hw_cursor = -1;
     screen_clear();
 }
 
+// Choose between origin moves (default) and copying the screen up
+void screen_set_hardware_scroll(int enabled) {
+    hardware_scroll = enabled;
+    if (!enabled && origin_row != 0) {
+        // Bring the visible rows back to the start of the window
+        for (int i = 0; i < VGA_WIDTH * VGA_HEIGHT; i++) {
+            shadow[i] = shadow[origin_row * VGA_WIDTH + i];
+        }
+        origin_row = 0;
+        mark_dirty(0, VGA_WIDTH * VGA_HEIGHT);
+        screen_flush();
+    }
+}
+
+// Copy all further output to fn (0 to stop)
+void screen_set_mirror(screen_mirror_t fn) {
+    mirror = fn;
+}
+
+// Stop (0) or resume drawing; output still reaches the mirror. With a
+// VBE mode set, VGA memory and the CRTC registers must be left alone.
+void screen_set_display(int enabled) {
+    display = enabled;
+}
+
 // Clear the entire screen
 void screen_clear() {
-    int i;
-    for (i = 0; i < VGA_WIDTH * VGA_HEIGHT * 2; i += 2) {
-        vga_memory[i] = ' ';
-        vga_memory[i + 1] = current_color;
-    }
+    origin_row = 0;
+    dirty_start = dirty_end = 0;
+    blank_cells(0, VGA_WIDTH * VGA_HEIGHT);
     cursor_x = 0;
     cursor_y = 0;
+    screen_flush();
 }
 
-// Scroll screen up by one line
-void screen_scroll() {
-    int i;
-    
-    // Move all lines up by one
-    for (i = 0; i < (VGA_HEIGHT - 1) * VGA_WIDTH * 2; i++) {
-        vga_memory[i] = vga_memory[i + VGA_WIDTH * 2];
+// Scroll the shadow up by one line (VGA memory is updated on the next flush)
+static void scroll_up() {
+    if (hardware_scroll && origin_row + VGA_HEIGHT < VGA_WINDOW_ROWS) {
+        // Move the display origin down one row; only the new bottom row
+        // needs writing
+        origin_row++;
+    } else {
+        // Copy mode, or the origin reached the end of the window: move
+        // the visible rows (minus the top one) to the start of the window.
+        // Nothing else in the window is shown any more, so the pending
+        // range restarts there.
+        int from = (origin_row + 1) * VGA_WIDTH;
+        for (int i = 0; i < (VGA_HEIGHT - 1) * VGA_WIDTH; i++) {
+            shadow[i] = shadow[from + i];
+        }
+        origin_row = 0;
+        dirty_start = dirty_end = 0;
+        mark_dirty(0, (VGA_HEIGHT - 1) * VGA_WIDTH);
     }
     
     // Clear the last line
-    int offset = (VGA_HEIGHT - 1) * VGA_WIDTH * 2;
-    for (i = 0; i < VGA_WIDTH * 2; i += 2) {
-        vga_memory[offset + i] = ' ';
-        vga_memory[offset + i + 1] = current_color;
-    }
+    blank_cells(get_offset(0, VGA_HEIGHT - 1), VGA_WIDTH);
     
     cursor_y = VGA_HEIGHT - 1;
 }
 
-// Put a single character on screen
-void screen_putchar(char c) {
-    int offset;
-    
+// Scroll screen up by one line
+void screen_scroll() {
+    scroll_up();
+    screen_flush();
+}
+
+// Put a single character into the shadow buffer
+static void screen_emit(char c) {
     // Handle special characters
     if (c == '\n') {
         cursor_x = 0;
@@ -73,15 +189,13 @@ void screen_putchar(char c) {
     } else if (c == '\b') {
         if (cursor_x > 0) {
             cursor_x--;
-            offset = get_offset(cursor_x, cursor_y);
-            vga_memory[offset] = ' ';
-            vga_memory[offset + 1] = current_color;
+            blank_cells(get_offset(cursor_x, cursor_y), 1);
         }
     } else {
         // Normal printable character
-        offset = get_offset(cursor_x, cursor_y);
-        vga_memory[offset] = c;
-        vga_memory[offset + 1] = current_color;
+        int offset = get_offset(cursor_x, cursor_y);
+        shadow[offset] = (current_color << 8) | (unsigned char)c;
+        mark_dirty(offset, offset + 1);
         cursor_x++;
     }
     
@@ -93,7 +207,18 @@ void screen_putchar(char c) {
     
     // Handle scrolling
     if (cursor_y >= VGA_HEIGHT) {
-        screen_scroll();
+        scroll_up();
+    }
+}
+
+// Put a single character on screen
+void screen_putchar(char c) {
+    if (display) {
+        screen_emit(c);
+        screen_flush();
+    }
+    if (mirror) {
+        mirror(&c, 1);
     }
 }
 
@@ -101,15 +226,36 @@ void screen_putchar(char c) {
 void screen_print(const char* str) {
     int i = 0;
     while (str[i] != '\0') {
-        screen_putchar(str[i]);
+        if (display) {
+            screen_emit(str[i]);
+        }
         i++;
     }
+    if (display) {
+        screen_flush();
+    }
+    if (mirror) {
+        mirror(str, i);
+    }
 }
 
 // Print a string with newline
 void screen_println(const char* str) {
-    screen_print(str);
-    screen_putchar('\n');
+    int i = 0;
+    while (str[i] != '\0') {
+        if (display) {
+            screen_emit(str[i]);
+        }
+        i++;
+    }
+    if (display) {
+        screen_emit('\n');
+        screen_flush();
+    }
+    if (mirror) {
+        mirror(str, i);
+        mirror("\n", 1);
+    }
 }
 
 // Set foreground and background color
@@ -0,0 +1,312 @@
+#include "../../Lib/include/serial.h"
+#include "../../Lib/include/keyboard.h"
+#include "../../Lib/include/input.h"
+#include "../../Lib/include/softirq.h"
+#include "../../Lib/include/thread.h"
+#include "../../Lib/include/cpu.h"
+#include "../../Lib/include/idt.h"
+#include "../../Lib/include/io.h"
+
+// UART registers (offsets from the base port)
+#define UART_DATA        0             // THR / RBR; divisor low with DLAB
+#define UART_IER         1             // Interrupt enable; divisor high with DLAB
+#define UART_IIR         2             // Interrupt identification (read)
+#define UART_FCR         2             // FIFO control (write)
+#define UART_LCR         3
+#define UART_MCR         4
+#define UART_LSR         5
+#define UART_MSR         6
+
+#define IER_RX           0x01          // Received data available
+#define IER_THRE         0x02          // Transmit holding register empty
+#define LCR_8N1          0x03
+#define LCR_DLAB         0x80
+#define FCR_ENABLE       0xC7          // Enable, clear both, 14-byte RX trigger
+#define MCR_OUT2         0x0B          // DTR, RTS, OUT2 (IRQ line enable)
+#define MCR_LOOPBACK     0x1E
+#define LSR_DATA         0x01
+#define LSR_THRE         0x20
+#define LSR_TEMT         0x40          // Transmitter completely idle
+
+#define IIR_NONE         0x01          // No interrupt pending
+#define IIR_ID_MASK      0x0E
+#define IIR_MODEM        0x00
+#define IIR_THRE         0x02
+#define IIR_RX           0x04
+#define IIR_LINE         0x06
+#define IIR_TIMEOUT      0x0C          // RX FIFO below trigger but idle
+
+// Bytes the transmit FIFO takes once it reports empty
+#define UART_FIFO_SIZE   16
+
+// External function to register IRQ handler
+extern void irq_install_handler(int irq, void (*handler)(void*));
+
+static int present = 0;
+static int have_tsc = 0;
+
+// Transmit ring: writers fill it, the THRE interrupt drains it. head
+// and tail run freely and are masked on use; both move with interrupts
+// disabled.
+static unsigned char tx_ring[SERIAL_TX_SIZE];
+static unsigned int tx_head = 0;
+static unsigned int tx_tail = 0;
+static int tx_active = 0;              // THRE interrupt enabled
+static wait_queue_t tx_waiters;        // Writers waiting for ring space
+
+// Received bytes from the IRQ (producer) for the softirq (consumer);
+// keycode holds the byte
+static input_queue_t rx_queue;
+
+// Escape sequence state for arrow and page keys
+static int escape_state = 0;
+static unsigned char escape_key = 0;
+static int last_cr = 0;
+
+static serial_stats_t stats;
+
+// Move up to a FIFO's worth of the ring into the UART, or stop the
+// transmit interrupt when the ring is empty. Interrupts disabled, and
+// the FIFO known to be empty.
+static void tx_fill() {
+    int sent = 0;
+
+    while (tx_tail != tx_head && sent < UART_FIFO_SIZE) {
+        outb(SERIAL_COM1 + UART_DATA, tx_ring[tx_tail & (SERIAL_TX_SIZE - 1)]);
+        tx_tail++;
+        sent++;
+    }
+    stats.tx_bytes += sent;
+
+    if (!sent) {
+        tx_active = 0;
+        outb(SERIAL_COM1 + UART_IER, IER_RX);
+    } else if (!tx_active) {
+        tx_active = 1;
+        outb(SERIAL_COM1 + UART_IER, IER_RX | IER_THRE);
+    }
+}
+
+// Append one byte, waiting for space if the caller may sleep. Runs
+// with interrupts disabled; flags are the caller's saved EFLAGS.
+static int tx_put(unsigned char c, unsigned int flags) {
+    while (tx_head - tx_tail == SERIAL_TX_SIZE) {
+        if (!(flags & 0x200) || !sched_running()) {
+            // Interrupt context or early boot: nothing will drain the
+            // ring while we wait
+            stats.tx_dropped++;
+            return 0;
+        }
+        if (!tx_active) {
+            tx_fill();
+        }
+        thread_wait(&tx_waiters);
+    }
+    tx_ring[tx_head & (SERIAL_TX_SIZE - 1)] = c;
+    tx_head++;
+    return 1;
+}
+
+// Turn a received byte into a keycode (0: none yet). Enter arrives as
+// CR, CR LF or LF; backspace as DEL; arrows and page keys as ANSI
+// escape sequences.
+static unsigned char serial_translate(unsigned char byte) {
+    int after_cr = last_cr;
+    last_cr = byte == '\r';
+
+    if (escape_state == 1) {
+        escape_state = byte == '[' ? 2 : 0;
+        return 0;
+    }
+    if (escape_state == 2) {
+        escape_state = 0;
+        if (byte == 'A') return KEY_UP;
+        if (byte == 'B') return KEY_DOWN;
+        if (byte == 'C') return KEY_RIGHT;
+        if (byte == 'D') return KEY_LEFT;
+        if (byte == '5' || byte == '6') {
+            escape_key = byte == '5' ? KEY_PGUP : KEY_PGDN;
+            escape_state = 3;
+        }
+        return 0;
+    }
+    if (escape_state == 3) {
+        escape_state = 0;
+        return byte == '~' ? escape_key : 0;
+    }
+
+    if (byte == 0x1B) {
+        escape_state = 1;
+        return 0;
+    }
+    if (byte == '\r') {
+        return '\n';
+    }
+    if (byte == '\n') {
+        return after_cr ? 0 : '\n';
+    }
+    if (byte == 0x7F) {
+        return '\b';
+    }
+    return byte;
+}
+
+// Serial bottom half: translate received bytes into key events
+static void serial_softirq(void* data) {
+    input_event_t batch[16];
+    int count;
+
+    while ((count = input_queue_pop(&rx_queue, batch, 16)) > 0) {
+        for (int i = 0; i < count; i++) {
+            batch[i].keycode = serial_translate(batch[i].keycode);
+            if (batch[i].keycode) {
+                keyboard_push_event(&batch[i]);
+            }
+        }
+    }
+}
+
+// COM1 interrupt handler (top half): refill the transmit FIFO and
+// capture received bytes
+static void serial_handler(void* regs) {
+    unsigned char iir;
+    int received = 0;
+
+    while (!((iir = inb(SERIAL_COM1 + UART_IIR)) & IIR_NONE)) {
+        int id = iir & IIR_ID_MASK;
+
+        if (id == IIR_RX || id == IIR_TIMEOUT) {
+            while (inb(SERIAL_COM1 + UART_LSR) & LSR_DATA) {
+                input_event_t event;
+                event.tsc = have_tsc ? rdtsc() : 0;
+                event.scancode = 0;
+                event.keycode = inb(SERIAL_COM1 + UART_DATA);
+                event.modifiers = 0;
+                event.pressed = 1;
+                stats.rx_bytes++;
+                if (!input_queue_push(&rx_queue, &event)) {
+                    stats.rx_dropped++;
+                }
+                received = 1;
+            }
+        } else if (id == IIR_THRE) {
+            tx_fill();
+            if (tx_waiters.head && SERIAL_TX_SIZE - (tx_head - tx_tail) >= SERIAL_TX_SIZE / 2) {
+                thread_wake_all(&tx_waiters);
+            }
+        } else if (id == IIR_LINE) {
+            inb(SERIAL_COM1 + UART_LSR);
+        } else if (id == IIR_MODEM) {
+            inb(SERIAL_COM1 + UART_MSR);
+        }
+    }
+
+    if (received) {
+        softirq_raise(SOFTIRQ_SERIAL);
+    }
+}
+
+// Probe and program COM1 (returns 0 if there is no UART)
+int serial_init() {
+    // Loopback check: a missing port reads back 0xFF
+    outb(SERIAL_COM1 + UART_IER, 0);
+    outb(SERIAL_COM1 + UART_MCR, MCR_LOOPBACK);
+    outb(SERIAL_COM1 + UART_DATA, 0xAE);
+    if (inb(SERIAL_COM1 + UART_DATA) != 0xAE) {
+        return 0;
+    }
+
+    outb(SERIAL_COM1 + UART_LCR, LCR_DLAB);
+    outb(SERIAL_COM1 + UART_DATA, (115200 / SERIAL_BAUD) & 0xFF);
+    outb(SERIAL_COM1 + UART_IER, (115200 / SERIAL_BAUD) >> 8);
+    outb(SERIAL_COM1 + UART_LCR, LCR_8N1);
+    outb(SERIAL_COM1 + UART_FCR, FCR_ENABLE);
+    outb(SERIAL_COM1 + UART_MCR, MCR_OUT2);
+
+    have_tsc = cpu_has(CPU_FEATURE_TSC);
+    input_queue_init(&rx_queue);
+    wait_queue_init(&tx_waiters);
+    softirq_register(SOFTIRQ_SERIAL, serial_softirq, 0);
+    irq_install_handler(SERIAL_IRQ, (void (*)(void*))serial_handler);
+
+    // Anything left in the receiver from before is not input
+    while (inb(SERIAL_COM1 + UART_LSR) & LSR_DATA) {
+        inb(SERIAL_COM1 + UART_DATA);
+    }
+    outb(SERIAL_COM1 + UART_IER, IER_RX);
+    irq_unmask(SERIAL_IRQ);
+
+    present = 1;
+    return 1;
+}
+
+// Check whether COM1 is in use
+int serial_present() {
+    return present;
+}
+
+// Queue length bytes for output, LF sent as CR LF and backspace as an
+// erase, as the terminal does. Returns without touching the UART
+// unless the transmitter is idle.
+void serial_write(const char* data, int length) {
+    if (!present) {
+        return;
+    }
+
+    unsigned int flags = irq_save();
+    for (int i = 0; i < length; i++) {
+        if (data[i] == '\n' && !tx_put('\r', flags)) {
+            break;
+        }
+        if (data[i] == '\b' && !(tx_put('\b', flags) && tx_put(' ', flags))) {
+            break;
+        }
+        if (!tx_put(data[i], flags)) {
+            break;
+        }
+    }
+
+    // Start the transmitter; from then on the interrupt keeps it fed
+    if (!tx_active && (inb(SERIAL_COM1 + UART_LSR) & LSR_THRE)) {
+        tx_fill();
+    }
+    irq_restore(flags);
+}
+
+// Queue a string for output
+void serial_print(const char* str) {
+    int length = 0;
+    while (str[length]) {
+        length++;
+    }
+    serial_write(str, length);
+}
+
+// Push everything queued out of the UART by polling, for callers that
+// are about to stop the machine
+void serial_flush() {
+    if (!present) {
+        return;
+    }
+
+    unsigned int flags = irq_save();
+    while (tx_tail != tx_head) {
+        if (inb(SERIAL_COM1 + UART_LSR) & LSR_THRE) {
+            tx_fill();
+        }
+        cpu_pause();
+    }
+    while (!(inb(SERIAL_COM1 + UART_LSR) & LSR_TEMT)) {
+        cpu_pause();
+    }
+    if (tx_waiters.head) {
+        thread_wake_all(&tx_waiters);
+    }
+    irq_restore(flags);
+}
+
+void serial_get_stats(serial_stats_t* out) {
+    unsigned int flags = irq_save();
+    *out = stats;
+    irq_restore(flags);
+}
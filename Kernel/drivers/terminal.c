@@ -0,0 +1,469 @@
+#include "../../Lib/include/terminal.h"
+
+// Glyphs are drawn over an already painted cell background
+static const color_t glyph_bg = {0, 0, 0, 0};
+
+// Find or add a palette entry for a color. Once the palette is full a
+// new color gets the closest existing entry: cells and scrollback hold
+// indices, so an entry can never be changed.
+static unsigned char terminal_palette_index(terminal_t* term, color_t color) {
+    int best = 0;
+    int best_distance = -1;
+    
+    for (int i = 0; i < term->palette_count; i++) {
+        color_t p = term->palette[i];
+        int dr = p.r - color.r;
+        int dg = p.g - color.g;
+        int db = p.b - color.b;
+        int da = p.a - color.a;
+        int distance = dr * dr + dg * dg + db * db + da * da;
+        if (distance == 0) {
+            return i;
+        }
+        if (best_distance < 0 || distance < best_distance) {
+            best = i;
+            best_distance = distance;
+        }
+    }
+    
+    if (term->palette_count == TERMINAL_PALETTE_SIZE) {
+        return best;
+    }
+    
+    term->palette[term->palette_count] = color;
+    return term->palette_count++;
+}
+
+// Stored row for a screen row
+static inline int terminal_ring_row(terminal_t* term, int row) {
+    int index = term->top + row;
+    return index >= term->rows ? index - term->rows : index;
+}
+
+// Cells of a screen row
+static inline terminal_cell_t* terminal_row(terminal_t* term, int row) {
+    return term->cells[terminal_ring_row(term, row)];
+}
+
+// Mark one cell of a screen row for repaint
+static inline void terminal_mark_cell(terminal_t* term, int col, int row) {
+    int index = terminal_ring_row(term, row);
+    term->cell_dirty[index][col >> 5] |= 1u << (col & 31);
+    term->row_dirty[index] = 1;
+    term->any_dirty = 1;
+}
+
+// Mark a whole stored row for repaint
+static void terminal_mark_ring_row(terminal_t* term, int index) {
+    for (int i = 0; i < TERMINAL_MAX_COLS / 32; i++) {
+        term->cell_dirty[index][i] = 0xFFFFFFFF;
+    }
+    term->row_dirty[index] = 1;
+    term->any_dirty = 1;
+}
+
+// Mark every row for repaint
+static void terminal_mark_all(terminal_t* term) {
+    for (int i = 0; i < term->rows; i++) {
+        terminal_mark_ring_row(term, i);
+    }
+}
+
+// Blank a stored row with the current colors
+static void terminal_blank_ring_row(terminal_t* term, int index) {
+    terminal_cell_t blank = {' ', term->fg, term->bg, 0};
+    for (int col = 0; col < term->cols; col++) {
+        term->cells[index][col] = blank;
+    }
+    terminal_mark_ring_row(term, index);
+}
+
+// Scrollback byte ring access
+static inline unsigned char scrollback_get(terminal_scrollback_t* sb, unsigned int offset) {
+    return sb->data[offset % TERMINAL_SCROLLBACK_BYTES];
+}
+
+static inline void scrollback_put(terminal_scrollback_t* sb, unsigned int offset, unsigned char value) {
+    sb->data[offset % TERMINAL_SCROLLBACK_BYTES] = value;
+}
+
+// Encoded size of the line starting at offset
+static unsigned int scrollback_line_size(terminal_scrollback_t* sb, unsigned int offset) {
+    return 2 + scrollback_get(sb, offset) + 3 * scrollback_get(sb, offset + 1);
+}
+
+// Append a row to the history, evicting the oldest lines to make room
+static void scrollback_push(terminal_t* term, const terminal_cell_t* cells) {
+    terminal_scrollback_t* sb = &term->scrollback;
+    int cols = term->cols;
+    
+    // Text without trailing blanks
+    int text_len = cols;
+    while (text_len > 0 && cells[text_len - 1].ch == ' ') {
+        text_len--;
+    }
+    
+    // Attribute runs over the whole row (blank cells keep their colors)
+    int runs = 1;
+    for (int col = 1; col < cols; col++) {
+        if (cells[col].fg != cells[col - 1].fg || cells[col].bg != cells[col - 1].bg) {
+            runs++;
+        }
+    }
+    
+    unsigned int size = 2 + text_len + 3 * runs;
+    while (sb->count > 0 &&
+           (sb->count == TERMINAL_SCROLLBACK_LINES || TERMINAL_SCROLLBACK_BYTES - sb->used < size)) {
+        sb->used -= scrollback_line_size(sb, sb->offsets[sb->first]);
+        sb->first = (sb->first + 1) % TERMINAL_SCROLLBACK_LINES;
+        sb->count--;
+    }
+    
+    unsigned int offset = sb->head;
+    sb->offsets[(sb->first + sb->count) % TERMINAL_SCROLLBACK_LINES] = offset;
+    scrollback_put(sb, offset++, text_len);
+    scrollback_put(sb, offset++, runs);
+    for (int col = 0; col < text_len; col++) {
+        scrollback_put(sb, offset++, cells[col].ch);
+    }
+    
+    int start = 0;
+    for (int col = 1; col <= cols; col++) {
+        if (col == cols || cells[col].fg != cells[start].fg || cells[col].bg != cells[start].bg) {
+            scrollback_put(sb, offset++, cells[start].fg);
+            scrollback_put(sb, offset++, cells[start].bg);
+            scrollback_put(sb, offset++, col - start);
+            start = col;
+        }
+    }
+    
+    sb->head = offset % TERMINAL_SCROLLBACK_BYTES;
+    sb->used += size;
+    sb->count++;
+}
+
+// Decode history line (0 = oldest) into the terminal's decode buffer
+static terminal_cell_t* scrollback_line(terminal_t* term, int line) {
+    terminal_scrollback_t* sb = &term->scrollback;
+    terminal_cell_t* cells = term->history_row;
+    unsigned int offset = sb->offsets[(sb->first + line) % TERMINAL_SCROLLBACK_LINES];
+    int text_len = scrollback_get(sb, offset);
+    int runs = scrollback_get(sb, offset + 1);
+    
+    offset += 2;
+    for (int col = 0; col < term->cols; col++) {
+        cells[col].ch = col < text_len ? scrollback_get(sb, offset + col) : ' ';
+        cells[col].flags = 0;
+    }
+    offset += text_len;
+    
+    int col = 0;
+    for (int i = 0; i < runs; i++) {
+        unsigned char fg = scrollback_get(sb, offset);
+        unsigned char bg = scrollback_get(sb, offset + 1);
+        int length = scrollback_get(sb, offset + 2);
+        offset += 3;
+        while (length-- > 0 && col < term->cols) {
+            cells[col].fg = fg;
+            cells[col].bg = bg;
+            col++;
+        }
+    }
+    return cells;
+}
+
+// Scroll the grid up by one row: the top row goes to the scrollback and
+// is reused as the new (blank) bottom row
+static void terminal_scroll(terminal_t* term) {
+    int index = term->top;
+    
+    scrollback_push(term, term->cells[index]);
+    term->top = terminal_ring_row(term, 1);
+    terminal_blank_ring_row(term, index);
+    term->pending_scroll++;
+    term->cursor_y = term->rows - 1;
+}
+
+// Initialize a terminal at pixel (x, y) with a cols x rows grid
+void terminal_init(terminal_t* term, int x, int y, int cols, int rows) {
+    if (cols > TERMINAL_MAX_COLS) cols = TERMINAL_MAX_COLS;
+    if (rows > TERMINAL_MAX_ROWS) rows = TERMINAL_MAX_ROWS;
+    
+    term->x = x;
+    term->y = y;
+    term->cols = cols;
+    term->rows = rows;
+    term->cursor_visible = 1;
+    term->mirror = 0;
+    term->palette_count = 0;
+    term->scrollback.first = 0;
+    term->scrollback.count = 0;
+    term->scrollback.head = 0;
+    term->scrollback.used = 0;
+    term->fg = terminal_palette_index(term, COLOR_WHITE);
+    term->bg = terminal_palette_index(term, (color_t){0, 0, 0, 180});
+    
+    terminal_clear(term);
+}
+
+// Clear the terminal and home the cursor
+void terminal_clear(terminal_t* term) {
+    term->top = 0;
+    for (int row = 0; row < term->rows; row++) {
+        terminal_blank_ring_row(term, row);
+    }
+    term->bg_translucent = term->palette[term->bg].a != 255;
+    term->pending_scroll = 0;
+    term->view_offset = 0;
+    term->cursor_x = 0;
+    term->cursor_y = 0;
+    term->drawn_cursor_x = 0;
+    term->drawn_cursor_y = 0;
+}
+
+// Set colors for following output
+void terminal_set_color(terminal_t* term, color_t fg, color_t bg) {
+    term->fg = terminal_palette_index(term, fg);
+    term->bg = terminal_palette_index(term, bg);
+    if (bg.a != 255) {
+        term->bg_translucent = 1;
+    }
+}
+
+// Copy all further output to mirror (0 to stop)
+void terminal_set_mirror(terminal_t* term, terminal_mirror_t mirror) {
+    term->mirror = mirror;
+}
+
+// Put a single character into the cells
+static void terminal_emit(terminal_t* term, char c) {
+    // New output snaps the view back to the live screen
+    if (term->view_offset) {
+        term->view_offset = 0;
+        terminal_mark_all(term);
+    }
+    
+    if (c == '\n') {
+        term->cursor_x = 0;
+        term->cursor_y++;
+    } else if (c == '\r') {
+        term->cursor_x = 0;
+    } else if (c == '\t') {
+        term->cursor_x = (term->cursor_x + 4) & ~(4 - 1);
+    } else if (c == '\b') {
+        if (term->cursor_x > 0) {
+            term->cursor_x--;
+            terminal_cell_t blank = {' ', term->fg, term->bg, 0};
+            terminal_row(term, term->cursor_y)[term->cursor_x] = blank;
+            terminal_mark_cell(term, term->cursor_x, term->cursor_y);
+        }
+    } else {
+        terminal_cell_t* cell = &terminal_row(term, term->cursor_y)[term->cursor_x];
+        if (cell->ch != (unsigned char)c || cell->fg != term->fg || cell->bg != term->bg) {
+            cell->ch = c;
+            cell->fg = term->fg;
+            cell->bg = term->bg;
+            terminal_mark_cell(term, term->cursor_x, term->cursor_y);
+        }
+        term->cursor_x++;
+    }
+    
+    // Handle line wrap
+    if (term->cursor_x >= term->cols) {
+        term->cursor_x = 0;
+        term->cursor_y++;
+    }
+    
+    // Handle scrolling
+    if (term->cursor_y >= term->rows) {
+        terminal_scroll(term);
+    }
+}
+
+// Put a single character (no drawing until terminal_render)
+void terminal_putchar(terminal_t* term, char c) {
+    terminal_emit(term, c);
+    if (term->mirror) {
+        term->mirror(&c, 1);
+    }
+}
+
+// Print a string
+void terminal_print(terminal_t* term, const char* str) {
+    int length = 0;
+    while (str[length]) {
+        terminal_emit(term, str[length++]);
+    }
+    if (term->mirror) {
+        term->mirror(str, length);
+    }
+}
+
+// Print a string with newline
+void terminal_println(terminal_t* term, const char* str) {
+    terminal_print(term, str);
+    terminal_putchar(term, '\n');
+}
+
+// Show or hide the cursor
+void terminal_set_cursor_visible(terminal_t* term, int visible) {
+    term->cursor_visible = visible;
+    terminal_mark_cell(term, term->cursor_x, term->cursor_y);
+}
+
+// Mark every cell overlapping a pixel rectangle for repaint (e.g. after
+// something else was drawn over the terminal)
+void terminal_invalidate(terminal_t* term, int x, int y, int width, int height) {
+    int col0 = (x - term->x) / TERMINAL_CELL_WIDTH;
+    int row0 = (y - term->y) / TERMINAL_CELL_HEIGHT;
+    int col1 = (x + width - term->x + TERMINAL_CELL_WIDTH - 1) / TERMINAL_CELL_WIDTH;
+    int row1 = (y + height - term->y + TERMINAL_CELL_HEIGHT - 1) / TERMINAL_CELL_HEIGHT;
+    
+    if (col0 < 0) col0 = 0;
+    if (row0 < 0) row0 = 0;
+    if (col1 > term->cols) col1 = term->cols;
+    if (row1 > term->rows) row1 = term->rows;
+    
+    for (int row = row0; row < row1; row++) {
+        for (int col = col0; col < col1; col++) {
+            terminal_mark_cell(term, col, row);
+        }
+    }
+}
+
+// Page through the scrollback: positive lines go back in history,
+// negative lines come forward; 0 is the live screen
+void terminal_scroll_view(terminal_t* term, int lines) {
+    int offset = term->view_offset + lines;
+    
+    if (offset > term->scrollback.count) offset = term->scrollback.count;
+    if (offset < 0) offset = 0;
+    if (offset != term->view_offset) {
+        term->view_offset = offset;
+        terminal_mark_all(term);
+    }
+}
+
+// Paint cells [col0, col1) of a screen row, which share the same colors
+static void terminal_paint_run(terminal_t* term, const terminal_cell_t* cells, int row,
+                               int col0, int col1) {
+    color_t fg = term->palette[cells[col0].fg];
+    color_t bg = term->palette[cells[col0].bg];
+    int px = term->x + col0 * TERMINAL_CELL_WIDTH;
+    int py = term->y + row * TERMINAL_CELL_HEIGHT;
+    int width = (col1 - col0) * TERMINAL_CELL_WIDTH;
+    char text[TERMINAL_MAX_COLS];
+    
+    // Background: opaque fill, wallpaper, or wallpaper under a
+    // translucent fill (one copy from the tinted wallpaper)
+    if (bg.a == 255) {
+        graphics_fill_rect(px, py, width, TERMINAL_CELL_HEIGHT, bg);
+    } else if (bg.a == 0) {
+        graphics_restore_background(px, py, width, TERMINAL_CELL_HEIGHT);
+    } else {
+        graphics_restore_tinted(px, py, width, TERMINAL_CELL_HEIGHT, bg);
+    }
+    
+    // Glyphs as one text run; trailing blanks draw nothing
+    int length = 0;
+    for (int col = col0; col < col1; col++) {
+        text[col - col0] = cells[col].ch;
+        if (cells[col].ch != ' ') {
+            length = col - col0 + 1;
+        }
+    }
+    graphics_draw_text(px, py, text, length, fg, glyph_bg);
+}
+
+// Repaint changed cells and the cursor
+void terminal_render(terminal_t* term) {
+    // Scrolled rows are already on screen, one text row higher per
+    // scroll. With opaque backgrounds their pixels do not depend on what
+    // is under the terminal, so one back buffer move replaces repainting
+    // them; only the new bottom rows (already dirty) are drawn. Under a
+    // translucent background every pixel carries the wallpaper at its own
+    // position, so moved pixels would be wrong; the rows are repainted,
+    // each a copy from the tinted wallpaper plus its glyphs.
+    if (term->pending_scroll) {
+        if (!term->bg_translucent && term->view_offset == 0 && term->pending_scroll < term->rows) {
+            graphics_scroll_rect(term->x, term->y, term->cols * TERMINAL_CELL_WIDTH,
+                                 term->rows * TERMINAL_CELL_HEIGHT,
+                                 term->pending_scroll * TERMINAL_CELL_HEIGHT);
+            term->drawn_cursor_y -= term->pending_scroll;
+        } else {
+            terminal_mark_all(term);
+        }
+        term->pending_scroll = 0;
+    }
+    
+    // A moved cursor dirties the cell it leaves and the one it enters
+    if (term->cursor_x != term->drawn_cursor_x || term->cursor_y != term->drawn_cursor_y) {
+        if (term->drawn_cursor_x < term->cols &&
+            term->drawn_cursor_y >= 0 && term->drawn_cursor_y < term->rows) {
+            terminal_mark_cell(term, term->drawn_cursor_x, term->drawn_cursor_y);
+        }
+        terminal_mark_cell(term, term->cursor_x, term->cursor_y);
+    }
+    
+    if (!term->any_dirty) {
+        return;
+    }
+    
+    // Viewing history: the top rows come from the scrollback and the
+    // live rows are shifted down
+    int history_rows = term->view_offset;
+    int history_first = term->scrollback.count - term->view_offset;
+    int cursor_painted = 0;
+    
+    for (int row = 0; row < term->rows; row++) {
+        int index = terminal_ring_row(term, row);
+        if (!term->row_dirty[index]) {
+            continue;
+        }
+        
+        unsigned int* dirty = term->cell_dirty[index];
+        const terminal_cell_t* cells;
+        int col = 0;
+        
+        if (row < history_rows) {
+            cells = scrollback_line(term, history_first + row);
+        } else {
+            cells = terminal_row(term, row - history_rows);
+        }
+        
+        while (col < term->cols) {
+            if (!(dirty[col >> 5] & (1u << (col & 31)))) {
+                col++;
+                continue;
+            }
+            
+            // Extend the run over dirty cells with the same colors
+            int start = col;
+            col++;
+            while (col < term->cols && (dirty[col >> 5] & (1u << (col & 31))) &&
+                   cells[col].fg == cells[start].fg && cells[col].bg == cells[start].bg) {
+                col++;
+            }
+            
+            terminal_paint_run(term, cells, row, start, col);
+            if (row == term->cursor_y && term->cursor_x >= start && term->cursor_x < col) {
+                cursor_painted = 1;
+            }
+        }
+        
+        for (int i = 0; i < TERMINAL_MAX_COLS / 32; i++) {
+            dirty[i] = 0;
+        }
+        term->row_dirty[index] = 0;
+    }
+    term->any_dirty = 0;
+    
+    // Cursor: underline in the current foreground color (live view only)
+    if (cursor_painted && term->cursor_visible && term->view_offset == 0) {
+        graphics_hline(term->x + term->cursor_x * TERMINAL_CELL_WIDTH,
+                       term->y + term->cursor_y * TERMINAL_CELL_HEIGHT + TERMINAL_CELL_HEIGHT - 1,
+                       TERMINAL_CELL_WIDTH, term->palette[term->fg]);
+    }
+    term->drawn_cursor_x = term->cursor_x;
+    term->drawn_cursor_y = term->cursor_y;
+}
@@ -0,0 +1,296 @@
+#include "../Lib/include/heap.h"
+#include "../Lib/include/pmm.h"
+#include "../Lib/include/cpu.h"
+
+// Every slab is one frame: a header followed by equal-sized object
+// slots. kfree() finds the header by rounding the pointer down to the
+// frame; frame-sized allocations carry a header of their own there.
+#define SLAB_MAGIC  0x51AB51AB
+#define LARGE_MAGIC 0x1A26E000
+
+typedef struct slab {
+    unsigned int magic;
+    struct heap_cache* cache;
+    struct slab* next;
+    struct slab* prev;
+    void* free;                    // Free slots, linked through the slots
+    unsigned short used;
+    unsigned short capacity;
+} slab_t;
+
+// Slots start after the header, rounded to 32 bytes
+#define SLAB_HEADER_SIZE 32
+
+typedef struct {
+    unsigned int magic;
+    unsigned int frames;
+    unsigned int reserved[2];
+} large_header_t;
+
+typedef struct heap_cache {
+    unsigned int object_size;
+    unsigned int capacity;         // Slots per slab
+    slab_t* partial;               // Slabs with free slots (including empty)
+    slab_t* full;
+    unsigned int empty;            // Empty slabs kept for reuse (at most 1)
+    heap_cache_stats_t stats;
+} heap_cache_t;
+
+static heap_cache_t caches[HEAP_CACHE_COUNT];
+static heap_large_stats_t large_stats;
+
+// Arena chunks are at least this many frames
+#define ARENA_CHUNK_FRAMES 4
+
+struct arena_chunk {
+    arena_chunk_t* next;
+    unsigned int frames;
+};
+
+static void slab_link(slab_t** list, slab_t* slab) {
+    slab->prev = 0;
+    slab->next = *list;
+    if (slab->next) {
+        slab->next->prev = slab;
+    }
+    *list = slab;
+}
+
+static void slab_unlink(slab_t** list, slab_t* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+}
+
+// Set up the size classes
+void heap_init() {
+    for (int i = 0; i < HEAP_CACHE_COUNT; i++) {
+        heap_cache_t* cache = &caches[i];
+        cache->object_size = 1u << (HEAP_MIN_SHIFT + i);
+        cache->capacity = (FRAME_SIZE - SLAB_HEADER_SIZE) / cache->object_size;
+        cache->partial = 0;
+        cache->full = 0;
+        cache->empty = 0;
+        cache->stats.object_size = cache->object_size;
+        cache->stats.slabs = 0;
+        cache->stats.live = 0;
+        cache->stats.capacity = 0;
+        cache->stats.allocs = 0;
+        cache->stats.frees = 0;
+    }
+    large_stats.live = 0;
+    large_stats.frames = 0;
+    large_stats.allocs = 0;
+    large_stats.frees = 0;
+}
+
+// Carve a new frame into slots
+static slab_t* slab_create(heap_cache_t* cache) {
+    slab_t* slab = (slab_t*)pmm_alloc(0);
+    if (!slab) {
+        return 0;
+    }
+    
+    slab->magic = SLAB_MAGIC;
+    slab->cache = cache;
+    slab->used = 0;
+    slab->capacity = cache->capacity;
+    slab->free = 0;
+    
+    // Link slots in address order
+    char* slot = (char*)slab + SLAB_HEADER_SIZE + (cache->capacity - 1) * cache->object_size;
+    for (unsigned int i = 0; i < cache->capacity; i++) {
+        *(void**)slot = slab->free;
+        slab->free = slot;
+        slot -= cache->object_size;
+    }
+    
+    slab_link(&cache->partial, slab);
+    cache->empty++;
+    cache->stats.slabs++;
+    cache->stats.capacity += cache->capacity;
+    return slab;
+}
+
+static void* cache_alloc(heap_cache_t* cache) {
+    slab_t* slab = cache->partial;
+    if (!slab && !(slab = slab_create(cache))) {
+        return 0;
+    }
+    
+    void* object = slab->free;
+    slab->free = *(void**)object;
+    if (slab->used++ == 0) {
+        cache->empty--;
+    }
+    if (slab->used == slab->capacity) {
+        slab_unlink(&cache->partial, slab);
+        slab_link(&cache->full, slab);
+    }
+    
+    cache->stats.live++;
+    cache->stats.allocs++;
+    return object;
+}
+
+static void cache_free(slab_t* slab, void* object) {
+    heap_cache_t* cache = slab->cache;
+    
+    if (slab->used == slab->capacity) {
+        slab_unlink(&cache->full, slab);
+        slab_link(&cache->partial, slab);
+    }
+    *(void**)object = slab->free;
+    slab->free = object;
+    slab->used--;
+    cache->stats.live--;
+    cache->stats.frees++;
+    
+    // Keep one empty slab for the next allocation; return the rest
+    if (slab->used == 0) {
+        if (cache->empty > 0) {
+            slab_unlink(&cache->partial, slab);
+            slab->magic = 0;
+            pmm_free((unsigned int)slab, 0);
+            cache->stats.slabs--;
+            cache->stats.capacity -= cache->capacity;
+        } else {
+            cache->empty++;
+        }
+    }
+}
+
+// Allocate size bytes (0 on failure); 16-byte aligned
+void* kmalloc(unsigned int size) {
+    if (size == 0) {
+        return 0;
+    }
+    
+    if (size <= HEAP_MAX_SMALL) {
+        int index = 0;
+        while ((1u << (HEAP_MIN_SHIFT + index)) < size) {
+            index++;
+        }
+        
+        // Caches are shared between threads
+        unsigned int flags = irq_save();
+        void* ptr = cache_alloc(&caches[index]);
+        irq_restore(flags);
+        return ptr;
+    }
+    
+    unsigned int frames = (size + sizeof(large_header_t) + FRAME_SIZE - 1) / FRAME_SIZE;
+    large_header_t* header = (large_header_t*)pmm_alloc_pages(frames);
+    if (!header) {
+        return 0;
+    }
+    header->magic = LARGE_MAGIC;
+    header->frames = frames;
+    unsigned int flags = irq_save();
+    large_stats.live++;
+    large_stats.frames += frames;
+    large_stats.allocs++;
+    irq_restore(flags);
+    return header + 1;
+}
+
+// Allocate zeroed memory
+void* kzalloc(unsigned int size) {
+    unsigned int* ptr = kmalloc(size);
+    if (ptr) {
+        unsigned int count = (size + 3) / 4;
+        for (unsigned int i = 0; i < count; i++) {
+            ptr[i] = 0;
+        }
+    }
+    return ptr;
+}
+
+// Free memory from kmalloc (ignores 0 and foreign pointers)
+void kfree(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    
+    unsigned int base = (unsigned int)ptr & ~(FRAME_SIZE - 1);
+    if (((slab_t*)base)->magic == SLAB_MAGIC) {
+        unsigned int flags = irq_save();
+        cache_free((slab_t*)base, ptr);
+        irq_restore(flags);
+        return;
+    }
+    
+    large_header_t* header = (large_header_t*)base;
+    if (header->magic == LARGE_MAGIC && (void*)(header + 1) == ptr) {
+        unsigned int frames = header->frames;
+        header->magic = 0;
+        pmm_free_pages(base, frames);
+        unsigned int flags = irq_save();
+        large_stats.live--;
+        large_stats.frames -= frames;
+        large_stats.frees++;
+        irq_restore(flags);
+    }
+}
+
+// Report statistics for one size class
+void heap_get_cache_stats(int index, heap_cache_stats_t* stats) {
+    if (index >= 0 && index < HEAP_CACHE_COUNT) {
+        *stats = caches[index].stats;
+    }
+}
+
+// Report statistics for frame-sized allocations
+void heap_get_large_stats(heap_large_stats_t* stats) {
+    *stats = large_stats;
+}
+
+// Start an empty arena (no memory is taken until the first allocation)
+void arena_init(arena_t* arena) {
+    arena->chunks = 0;
+    arena->cursor = 0;
+    arena->limit = 0;
+    arena->used = 0;
+}
+
+// Allocate size bytes (8-byte aligned) from the arena
+void* arena_alloc(arena_t* arena, unsigned int size) {
+    size = (size + 7) & ~7u;
+    
+    if (!arena->cursor || (unsigned int)(arena->limit - arena->cursor) < size) {
+        unsigned int frames = (size + sizeof(arena_chunk_t) + FRAME_SIZE - 1) / FRAME_SIZE;
+        if (frames < ARENA_CHUNK_FRAMES) {
+            frames = ARENA_CHUNK_FRAMES;
+        }
+        arena_chunk_t* chunk = (arena_chunk_t*)pmm_alloc_pages(frames);
+        if (!chunk) {
+            return 0;
+        }
+        chunk->next = arena->chunks;
+        chunk->frames = frames;
+        arena->chunks = chunk;
+        arena->cursor = (char*)chunk + ((sizeof(arena_chunk_t) + 7) & ~7u);
+        arena->limit = (char*)chunk + frames * FRAME_SIZE;
+    }
+    
+    void* ptr = arena->cursor;
+    arena->cursor += size;
+    arena->used += size;
+    return ptr;
+}
+
+// Free everything allocated from the arena
+void arena_release(arena_t* arena) {
+    arena_chunk_t* chunk = arena->chunks;
+    while (chunk) {
+        arena_chunk_t* next = chunk->next;
+        pmm_free_pages((unsigned int)chunk, chunk->frames);
+        chunk = next;
+    }
+    arena_init(arena);
+}
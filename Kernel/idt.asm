@@ -82,7 +82,30 @@ IRQ 13, 45
 IRQ 14, 46
 IRQ 15, 47
 
+; Software interrupt for thread_yield(); takes the IRQ path so the
+; scheduler can switch stacks on the way out
+IRQ yield, 48
+
+; Local APIC timer (the scheduling tick in APIC mode) and spurious vector
+IRQ lapic_timer, 64
+IRQ spurious, 127
+
+; Work-dispatch IPI to application processors
+IRQ smp_work, 65
+
 extern isr_handler
+extern irqstat_record
+extern irqstat_tsc
+
+; Timestamp in edx:eax, or zero when the CPU has no TSC
+%macro READ_TSC 0
+    xor eax, eax
+    xor edx, edx
+    cmp dword [irqstat_tsc], 0
+    je %%done
+    rdtsc
+%%done:
+%endmacro
 
 isr_common_stub:
     pusha
@@ -97,9 +120,22 @@ isr_common_stub:
     mov fs, ax
     mov gs, ax
     
-    push esp
+    mov ebx, esp                ; Interrupted frame
+    READ_TSC                    ; Entry timestamp, kept in callee-saved
+    mov edi, eax                ; registers (pusha already saved them)
+    mov ebp, edx
+    
+    push ebx
     call isr_handler
-    add esp, 4
+    
+    READ_TSC                    ; Exit timestamp
+    push edx
+    push eax
+    push ebp
+    push edi
+    push ebx
+    call irqstat_record
+    mov esp, ebx
     
     pop gs
     pop fs
@@ -125,9 +161,23 @@ irq_common_stub:
     mov fs, ax
     mov gs, ax
     
-    push esp
+    mov ebx, esp                ; Interrupted frame
+    READ_TSC                    ; Entry timestamp
+    mov edi, eax
+    mov ebp, edx
+    
+    push ebx
     call irq_handler
-    add esp, 4
+    mov esi, eax                ; Frame to resume, possibly another thread's
+    
+    READ_TSC                    ; Exit timestamp, taken before the switch
+    push edx
+    push eax
+    push ebp
+    push edi
+    push ebx
+    call irqstat_record
+    mov esp, esi
     
     pop gs
     pop fs
@@ -1,5 +1,8 @@
 #include "../Lib/include/idt.h"
 #include "../Lib/include/screen.h"
+#include "../Lib/include/apic.h"
+#include "../Lib/include/smp.h"
+#include "../Lib/include/irqstat.h"
 
 // IDT with 256 entries
 struct idt_entry idt[256];
@@ -23,11 +26,107 @@ static void pic_remap() {
     __asm__ __volatile__("outb %0, %1" : : "a"((unsigned char)0x01), "Nd"((unsigned short)0x21));
     __asm__ __volatile__("outb %0, %1" : : "a"((unsigned char)0x01), "Nd"((unsigned short)0xA1));
     
-    // Mask all interrupts except keyboard (IRQ1)
+    // Mask all interrupts except keyboard (IRQ1); drivers unmask their
+    // own lines with pic_unmask()
     __asm__ __volatile__("outb %0, %1" : : "a"((unsigned char)0xFD), "Nd"((unsigned short)0x21));
     __asm__ __volatile__("outb %0, %1" : : "a"((unsigned char)0xFF), "Nd"((unsigned short)0xA1));
 }
 
+// Enable an IRQ line (the cascade line is enabled for slave IRQs)
+void pic_unmask(int irq) {
+    unsigned short port = irq < 8 ? 0x21 : 0xA1;
+    unsigned char mask;
+    
+    __asm__ __volatile__("inb %1, %0" : "=a"(mask) : "Nd"(port));
+    mask &= ~(1 << (irq & 7));
+    __asm__ __volatile__("outb %0, %1" : : "a"(mask), "Nd"(port));
+    
+    if (irq >= 8) {
+        pic_unmask(2);
+    }
+}
+
+// Disable an IRQ line
+void pic_mask(int irq) {
+    unsigned short port = irq < 8 ? 0x21 : 0xA1;
+    unsigned char mask;
+    
+    __asm__ __volatile__("inb %1, %0" : "=a"(mask) : "Nd"(port));
+    mask |= 1 << (irq & 7);
+    __asm__ __volatile__("outb %0, %1" : : "a"(mask), "Nd"(port));
+}
+
+// Read both PIC masks (bit n set: IRQ n disabled)
+unsigned short pic_get_mask() {
+    unsigned char master, slave;
+    __asm__ __volatile__("inb %1, %0" : "=a"(master) : "Nd"((unsigned short)0x21));
+    __asm__ __volatile__("inb %1, %0" : "=a"(slave) : "Nd"((unsigned short)0xA1));
+    return master | (slave << 8);
+}
+
+// Write both PIC masks
+void pic_set_mask(unsigned short mask) {
+    __asm__ __volatile__("outb %0, %1" : : "a"((unsigned char)(mask & 0xFF)), "Nd"((unsigned short)0x21));
+    __asm__ __volatile__("outb %0, %1" : : "a"((unsigned char)(mask >> 8)), "Nd"((unsigned short)0xA1));
+}
+
+// Enable an IRQ line on whichever controller delivers it
+void irq_unmask(int irq) {
+    if (apic_active()) {
+        ioapic_unmask(irq);
+    } else {
+        pic_unmask(irq);
+    }
+}
+
+// Disable an IRQ line on whichever controller delivers it
+void irq_mask(int irq) {
+    if (apic_active()) {
+        ioapic_mask(irq);
+    } else {
+        pic_mask(irq);
+    }
+}
+
+// Acknowledge an IRQ
+void irq_eoi(int irq) {
+    if (apic_active()) {
+        apic_eoi();
+        return;
+    }
+    
+    if (irq >= 8) {
+        // Send EOI to slave PIC
+        __asm__ __volatile__("outb %0, %1" : : "a"((unsigned char)0x20), "Nd"((unsigned short)0xA0));
+    }
+    // Send EOI to master PIC
+    __asm__ __volatile__("outb %0, %1" : : "a"((unsigned char)0x20), "Nd"((unsigned short)0x20));
+}
+
+// Check whether IRQ 7 or 15 is spurious: the PIC raised it but has no
+// matching bit in service. A spurious IRQ 15 still came through the
+// master's cascade line, so the master gets its EOI.
+int pic_spurious(int irq) {
+    unsigned short port = irq < 8 ? 0x20 : 0xA0;
+    unsigned char isr;
+    
+    if (apic_active()) {
+        return 0;
+    }
+    
+    // OCW3: read the in-service register
+    __asm__ __volatile__("outb %0, %1" : : "a"((unsigned char)0x0B), "Nd"(port));
+    __asm__ __volatile__("inb %1, %0" : "=a"(isr) : "Nd"(port));
+    if (isr & (1 << (irq & 7))) {
+        return 0;
+    }
+    
+    if (irq >= 8) {
+        __asm__ __volatile__("outb %0, %1" : : "a"((unsigned char)0x20), "Nd"((unsigned short)0x20));
+    }
+    return 1;
+}
+
 // Set an IDT gate
 void idt_set_gate(unsigned char num, unsigned int base, unsigned short selector, unsigned char flags) {
     idt[num].base_low = base & 0xFFFF;
@@ -37,6 +136,11 @@ void idt_set_gate(unsigned char num, unsigned int base, unsigned short selector,
     idt[num].flags = flags;
 }
 
+// Load the (shared) IDT on the running CPU
+void idt_load_cpu() {
+    idt_load((unsigned int)&idtp);
+}
+
 // Initialize IDT
 void idt_init() {
     int i;
@@ -105,8 +209,21 @@ void idt_init() {
     idt_set_gate(46, (unsigned int)irq_14, 0x08, 0x8E);
     idt_set_gate(47, (unsigned int)irq_15, 0x08, 0x8E);
     
+    // Thread yield (software interrupt)
+    idt_set_gate(48, (unsigned int)irq_yield, 0x08, 0x8E);
+    
+    // Local APIC timer and spurious interrupts
+    idt_set_gate(LAPIC_TIMER_VECTOR, (unsigned int)irq_lapic_timer, 0x08, 0x8E);
+    idt_set_gate(LAPIC_SPURIOUS_VECTOR, (unsigned int)irq_spurious, 0x08, 0x8E);
+    
+    // Work posted for application processors
+    idt_set_gate(SMP_WORK_VECTOR, (unsigned int)irq_smp_work, 0x08, 0x8E);
+    
+    // Stubs check for a TSC before timing an interrupt
+    irqstat_init();
+    
     // Load IDT
-    idt_load((unsigned int)&idtp);
+    idt_load_cpu();
     
     // Enable interrupts
     __asm__ __volatile__("sti");
@@ -0,0 +1,50 @@
+#include "../Lib/include/input.h"
+#include "../Lib/include/cpu.h"
+
+void input_queue_init(input_queue_t* queue) {
+    queue->head = 0;
+    queue->tail = 0;
+    queue->pushed = 0;
+    queue->dropped = 0;
+}
+
+// Append an event (producer side); returns 0 if the queue was full
+int input_queue_push(input_queue_t* queue, const input_event_t* event) {
+    unsigned int head = queue->head;
+    
+    if (head - queue->tail >= INPUT_QUEUE_SIZE) {
+        queue->dropped++;
+        return 0;
+    }
+    queue->events[head & (INPUT_QUEUE_SIZE - 1)] = *event;
+    
+    // Publish the slot only after its contents are written
+    barrier();
+    queue->head = head + 1;
+    queue->pushed++;
+    return 1;
+}
+
+// Remove up to max events in order (consumer side); returns the count
+int input_queue_pop(input_queue_t* queue, input_event_t* out, int max) {
+    unsigned int tail = queue->tail;
+    unsigned int available = queue->head - tail;
+    int count = 0;
+    
+    // Read the slots only after seeing head move past them
+    barrier();
+    while (count < max && (unsigned int)count < available) {
+        out[count] = queue->events[(tail + count) & (INPUT_QUEUE_SIZE - 1)];
+        count++;
+    }
+    
+    // Hand the slots back only after copying them out
+    barrier();
+    queue->tail = tail + count;
+    return count;
+}
+
+// Events waiting (a snapshot; either side may call it)
+unsigned int input_queue_count(const input_queue_t* queue) {
+    return queue->head - queue->tail;
+}
@@ -0,0 +1,141 @@
+#include "../Lib/include/irqstat.h"
+#include "../Lib/include/isr.h"
+#include "../Lib/include/cpu.h"
+#include "../Lib/include/smp.h"
+
+// Per-vector cost records. Application processors take the work IPI
+// concurrently, so updates go under a lock; every caller already runs
+// with interrupts disabled.
+static irqstat_t vectors[IRQSTAT_VECTORS];
+static irqstat_totals_t totals;
+static volatile int stats_lock = 0;
+
+// Read by the common stubs in idt.asm
+int irqstat_tsc = 0;
+
+static void lock() {
+    int taken = 1;
+    while (1) {
+        __asm__ __volatile__("xchgl %0, %1" : "+r"(taken), "+m"(stats_lock) : : "memory");
+        if (!taken) {
+            return;
+        }
+        cpu_pause();
+        taken = 1;
+    }
+}
+
+static void unlock() {
+    barrier();
+    stats_lock = 0;
+}
+
+// Index of the highest set bit (0 for 0)
+static int log2_bucket(unsigned int cycles) {
+    int bucket = 0;
+    if (cycles) {
+        __asm__("bsrl %1, %0" : "=r"(bucket) : "rm"(cycles));
+    }
+    return bucket < IRQSTAT_BUCKETS ? bucket : IRQSTAT_BUCKETS - 1;
+}
+
+// Let the stubs time interrupts if this CPU has a TSC; rdtsc would
+// fault on one without
+void irqstat_init() {
+    irqstat_tsc = cpu_has(CPU_FEATURE_TSC);
+}
+
+// Called first thing by the C handlers: count entries that arrive
+// while this CPU is already inside one
+void irqstat_enter() {
+    cpu_t* cpu = cpu_current();
+    if (++cpu->irq_depth > 1) {
+        lock();
+        totals.nested++;
+        unlock();
+    }
+}
+
+// Account one pass through a common stub; entry and exit are the TSC
+// values the stub read around the C handler
+void irqstat_record(struct registers* regs, unsigned long long entry, unsigned long long exit) {
+    cpu_current()->irq_depth--;
+    
+    if (regs->int_no >= IRQSTAT_VECTORS) {
+        return;
+    }
+    
+    unsigned long long elapsed = exit - entry;
+    unsigned int cycles = elapsed >> 32 ? 0xFFFFFFFF : (unsigned int)elapsed;
+    irqstat_t* stats = &vectors[regs->int_no];
+    
+    lock();
+    if (stats->count == 0 || cycles < stats->min_cycles) {
+        stats->min_cycles = cycles;
+    }
+    if (cycles > stats->max_cycles) {
+        stats->max_cycles = cycles;
+    }
+    stats->count++;
+    stats->total_cycles += cycles;
+    stats->histogram[log2_bucket(cycles)]++;
+    unlock();
+}
+
+// Count a spurious interrupt: PIC IRQ 7 or 15, or -1 for the local APIC
+void irqstat_spurious(int irq) {
+    lock();
+    if (irq == 7) {
+        totals.spurious_pic7++;
+    } else if (irq == 15) {
+        totals.spurious_pic15++;
+    } else {
+        totals.spurious_lapic++;
+    }
+    unlock();
+}
+
+// Copy one vector's record (zeroed for vectors out of range)
+void irqstat_get(int vector, irqstat_t* stats) {
+    char* out = (char*)stats;
+    for (unsigned int i = 0; i < sizeof(irqstat_t); i++) {
+        out[i] = 0;
+    }
+    if (vector < 0 || vector >= IRQSTAT_VECTORS) {
+        return;
+    }
+    
+    unsigned int flags = irq_save();
+    lock();
+    *stats = vectors[vector];
+    unlock();
+    irq_restore(flags);
+    
+    if (stats->count) {
+        stats->avg_cycles = div64_32(stats->total_cycles, stats->count);
+    }
+}
+
+void irqstat_get_totals(irqstat_totals_t* out) {
+    unsigned int flags = irq_save();
+    lock();
+    *out = totals;
+    unlock();
+    irq_restore(flags);
+}
+
+// Start counting afresh
+void irqstat_reset() {
+    unsigned int flags = irq_save();
+    lock();
+    char* bytes = (char*)vectors;
+    for (unsigned int i = 0; i < sizeof(vectors); i++) {
+        bytes[i] = 0;
+    }
+    totals.nested = 0;
+    totals.spurious_pic7 = 0;
+    totals.spurious_pic15 = 0;
+    totals.spurious_lapic = 0;
+    unlock();
+    irq_restore(flags);
+}
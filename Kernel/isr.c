@@ -1,4 +1,9 @@
 #include "../Lib/include/screen.h"
+#include "../Lib/include/apic.h"
+#include "../Lib/include/idt.h"
+#include "../Lib/include/smp.h"
+#include "../Lib/include/irqstat.h"
+#include "../Lib/include/serial.h"
 
 // Registers saved on interrupt
 struct registers {
@@ -44,6 +49,9 @@ static const char* exception_messages[] = {
     "Reserved"
 };
 
+// Scheduler hook: frame to resume when the interrupt returns
+extern struct registers* sched_switch(struct registers* regs);
+
 // IRQ handler function pointers
 typedef void (*irq_handler_t)(struct registers*);
 static irq_handler_t irq_handlers[16] = {0};
@@ -60,12 +68,17 @@ void irq_uninstall_handler(int irq) {
 
 // ISR handler (CPU exceptions)
 void isr_handler(struct registers* regs) {
+    irqstat_enter();
+    
     if (regs->int_no < 32) {
         screen_set_color(COLOR_LIGHT_RED, COLOR_BLACK);
         screen_print("EXCEPTION: ");
         screen_println(exception_messages[regs->int_no]);
         screen_set_color(COLOR_WHITE, COLOR_BLACK);
         
+        // The mirror's copy must leave the UART before the CPU stops
+        serial_flush();
+        
         // Halt on exception
         while (1) {
             __asm__ __volatile__("hlt");
@@ -73,21 +86,46 @@ void isr_handler(struct registers* regs) {
     }
 }
 
-// IRQ handler (hardware interrupts)
-void irq_handler(struct registers* regs) {
-    // Call registered handler if exists
+// IRQ handler (hardware interrupts and thread yields). Returns the
+// register frame irq_common_stub resumes.
+struct registers* irq_handler(struct registers* regs) {
+    int irq = -1;
+    
+    irqstat_enter();
+    
+    // Application processors only take these, and must not reach the
+    // scheduler, which belongs to the boot CPU
+    if (regs->int_no == SMP_WORK_VECTOR) {
+        apic_eoi();
+        return regs;
+    }
+    if (regs->int_no == LAPIC_SPURIOUS_VECTOR) {
+        irqstat_spurious(-1);
+        return regs;
+    }
+    
     if (regs->int_no >= 32 && regs->int_no <= 47) {
-        int irq = regs->int_no - 32;
+        irq = regs->int_no - 32;
+    } else if (regs->int_no == LAPIC_TIMER_VECTOR) {
+        // The LAPIC timer stands in for the PIT
+        irq = 0;
+    }
+    
+    // A PIC line that dropped before it was acknowledged shows up as
+    // IRQ 7 or 15 with nothing in service; it gets no handler or EOI
+    if ((irq == 7 || irq == 15) && pic_spurious(irq)) {
+        irqstat_spurious(irq);
+        return regs;
+    }
+    
+    // Call registered handler if exists
+    if (irq >= 0) {
         if (irq_handlers[irq] != 0) {
             irq_handlers[irq](regs);
         }
+        irq_eoi(irq);
     }
     
-    // Send EOI (End of Interrupt) to PICs
-    if (regs->int_no >= 40) {
-        // Send EOI to slave PIC
-        __asm__ __volatile__("outb %0, %1" : : "a"((unsigned char)0x20), "Nd"((unsigned short)0xA0));
-    }
-    // Send EOI to master PIC
-    __asm__ __volatile__("outb %0, %1" : : "a"((unsigned char)0x20), "Nd"((unsigned short)0x20));
+    // Switch threads if this was a yield or the slice ran out
+    return sched_switch(regs);
 }
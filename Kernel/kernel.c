@@ -1,6 +1,7 @@
 #include "../Lib/include/screen.h"
 #include "../Lib/include/idt.h"
 #include "../Lib/include/keyboard.h"
+#include "../Lib/include/timer.h"
 #include "../user/shell/shell.h"
 
 void kernel_main() {
@@ -42,6 +43,14 @@ void kernel_main() {
     screen_set_color(COLOR_GREEN, COLOR_BLACK);
     screen_println(" OK");
     
+    screen_set_color(COLOR_YELLOW, COLOR_BLACK);
+    screen_print("[...] ");
+    screen_set_color(COLOR_WHITE, COLOR_BLACK);
+    screen_print("Starting timer...");
+    timer_init(TIMER_DEFAULT_HZ);
+    screen_set_color(COLOR_GREEN, COLOR_BLACK);
+    screen_println(" OK");
+    
     screen_set_color(COLOR_YELLOW, COLOR_BLACK);
     screen_print("[...] ");
     screen_set_color(COLOR_WHITE, COLOR_BLACK);
@@ -62,8 +71,8 @@ void kernel_main() {
     screen_println(">>> BOOT SUCCESSFUL <<<");
     screen_set_color(COLOR_WHITE, COLOR_BLACK);
     
-    // Wait a moment (simple delay)
-    for (volatile int i = 0; i < 50000000; i++);
+    // Wait a moment
+    sleep_ms(1500);
     
     // Clear screen before starting shell
     screen_clear();
@@ -0,0 +1,88 @@
+#include "../Lib/include/boot.h"
+#include "../Lib/include/pmm.h"
+#include "../Lib/include/heap.h"
+#include "../Lib/include/paging.h"
+#include "../Lib/include/graphics.h"
+#include "../Lib/include/terminal.h"
+#include "../Lib/include/idt.h"
+#include "../Lib/include/apic.h"
+#include "../Lib/include/smp.h"
+#include "../Lib/include/keyboard.h"
+#include "../Lib/include/serial.h"
+#include "../Lib/include/timer.h"
+#include "../Lib/include/thread.h"
+#include "../Lib/include/softirq.h"
+#include "../Lib/include/boottime.h"
+#include "../user/shell/shell.h"
+
+// Text-mode screen driver (screen.h's color names clash with graphics.h)
+extern void screen_set_mirror(void (*mirror)(const char* data, int length));
+extern void screen_set_display(int enabled);
+
+// Full-screen terminal over the wallpaper
+static terminal_t terminal;
+
+static void shell_thread(void* arg) {
+    shell_run_graphical((terminal_t*)arg);
+}
+
+void kernel_main() {
+    // The loader set a VBE mode: exception reports must not write VGA
+    // text memory or the CRTC registers
+    screen_set_display(0);
+    
+    // Loader stamps first; each init step below ends a boot phase
+    boottime_init(boot_info());
+    
+    // Physical memory from the bootloader's E820 map
+    pmm_init(boot_info());
+    heap_init();
+    boottime_mark("memory");
+    
+    // Identity-mapped paging first so graphics can map the LFB as WC
+    paging_init();
+    boottime_mark("paging");
+    
+    idt_init();
+    boottime_mark("idt");
+    
+    // Move to the local APIC/IOAPIC when the MADT lists them; the PIC
+    // stays in charge otherwise
+    apic_init();
+    boottime_mark("apic");
+    
+    timer_init(TIMER_DEFAULT_HZ);
+    boottime_mark("timer");
+    
+    // COM1 console, when there is one: a copy of the terminal output
+    // and a second input source for the shell. Exception reports go to
+    // the text screen driver, which stays off the display in VBE mode,
+    // so they go to the serial port only.
+    serial_init();
+    screen_set_mirror(serial_write);
+    boottime_mark("serial");
+    
+    // Other CPUs next, so they can share the full-screen graphics work
+    smp_init();
+    boottime_mark("smp");
+    
+    graphics_init();
+    graphics_load_wallpaper();
+    boottime_mark("graphics");
+    
+    terminal_init(&terminal, 0, 0, TERMINAL_MAX_COLS, TERMINAL_MAX_ROWS);
+    terminal_set_mirror(&terminal, serial_write);
+    boottime_mark("terminal");
+    
+    keyboard_init();
+    boottime_mark("keyboard");
+    
+    // Start graphical shell in its own thread; the boot context stays
+    // behind as the idle thread. The shell marks "prompt" once it is
+    // on screen.
+    sched_init();
+    softirq_init();
+    thread_create("shell", shell_thread, &terminal, THREAD_PRIORITY_NORMAL);
+    boottime_mark("threads");
+    thread_idle();
+}
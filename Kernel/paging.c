@@ -0,0 +1,218 @@
+#include "../Lib/include/paging.h"
+#include "../Lib/include/cpu.h"
+
+// Model-specific registers
+#define MSR_MTRR_CAP       0x0FE
+#define MSR_MTRR_PHYSBASE0 0x200
+#define MSR_MTRR_PHYSMASK0 0x201
+#define MSR_PAT            0x277
+#define MSR_MTRR_DEF_TYPE  0x2FF
+
+// PAT layout, entries 0-7: WB, WC, UC-, UC repeated. Entry 1 (PWT set,
+// PCD and PAT clear) is changed from WT to WC; the others keep their
+// power-on types, so PCD still means uncached.
+#define PAT_VALUE 0x0007010600070106ULL
+#define PAGE_WC PAGE_PWT
+
+// Identity map of the whole 4 GB address space: the first 4 MB through
+// a page table, everything above with 4 MB pages. The first 4 MB holds
+// the kernel and the BIOS areas whose fixed-range MTRRs mix memory
+// types, which a single large page must not span.
+static unsigned int page_directory[1024] __attribute__((aligned(PAGE_SIZE)));
+static unsigned int low_page_table[1024] __attribute__((aligned(PAGE_SIZE)));
+
+static int paging_on = 0;
+static int pat_ready = 0;
+
+// Flush caches and the TLB (required around memory type changes)
+static inline void flush_caches() {
+    __asm__ __volatile__("wbinvd" : : : "memory");
+}
+
+static inline void flush_tlb() {
+    unsigned int cr3;
+    __asm__ __volatile__("mov %%cr3, %0" : "=r"(cr3));
+    __asm__ __volatile__("mov %0, %%cr3" : : "r"(cr3) : "memory");
+}
+
+// Build the identity map and turn paging on (returns 0 without PSE)
+int paging_init() {
+    unsigned int cr0, cr4;
+    
+    if (paging_on) {
+        return 1;
+    }
+    if (!cpu_has(CPU_FEATURE_PSE)) {
+        return 0;
+    }
+    
+    for (unsigned int i = 0; i < 1024; i++) {
+        low_page_table[i] = (i * PAGE_SIZE) | PAGE_PRESENT | PAGE_WRITE;
+    }
+    page_directory[0] = (unsigned int)low_page_table | PAGE_PRESENT | PAGE_WRITE;
+    for (unsigned int i = 1; i < 1024; i++) {
+        page_directory[i] = (i * LARGE_PAGE_SIZE) | PAGE_PRESENT | PAGE_WRITE | PAGE_LARGE;
+    }
+    
+    // Program PAT before any mapping uses PWT for WC
+    if (cpu_has(CPU_FEATURE_PAT | CPU_FEATURE_MSR)) {
+        flush_caches();
+        wrmsr(MSR_PAT, PAT_VALUE);
+        pat_ready = 1;
+    }
+    
+    // CR4.PSE, then CR3 and CR0.PG
+    __asm__ __volatile__("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= (1 << 4);
+    __asm__ __volatile__("mov %0, %%cr4" : : "r"(cr4));
+    
+    __asm__ __volatile__("mov %0, %%cr3" : : "r"(page_directory) : "memory");
+    
+    __asm__ __volatile__("mov %%cr0, %0" : "=r"(cr0));
+    cr0 |= (1u << 31);
+    __asm__ __volatile__("mov %0, %%cr0" : : "r"(cr0) : "memory");
+    
+    paging_on = 1;
+    return 1;
+}
+
+// Turn paging on for an application processor: same directory, same
+// PAT (all CPUs must agree on memory types)
+void paging_init_ap() {
+    unsigned int cr0, cr4;
+    
+    if (!paging_on) {
+        return;
+    }
+    if (pat_ready) {
+        wrmsr(MSR_PAT, PAT_VALUE);
+    }
+    
+    __asm__ __volatile__("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= (1 << 4);
+    __asm__ __volatile__("mov %0, %%cr4" : : "r"(cr4));
+    
+    __asm__ __volatile__("mov %0, %%cr3" : : "r"(page_directory) : "memory");
+    
+    __asm__ __volatile__("mov %%cr0, %0" : "=r"(cr0));
+    cr0 |= (1u << 31);
+    __asm__ __volatile__("mov %0, %%cr0" : : "r"(cr0) : "memory");
+}
+
+// Check whether paging is on
+int paging_enabled() {
+    return paging_on;
+}
+
+// Physical address width for MTRR masks
+static unsigned int physical_address_bits() {
+    unsigned int eax, ebx, ecx, edx;
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if (eax < 0x80000008) {
+        return 36;
+    }
+    cpuid(0x80000008, &eax, &ebx, &ecx, &edx);
+    return eax & 0xFF;
+}
+
+// Cover [base, base + size) with a free variable-range MTRR of type WC.
+// The range is grown to a naturally aligned power of two.
+static int mtrr_set_wc(unsigned int base, unsigned int size) {
+    if (!cpu_has(CPU_FEATURE_MTRR | CPU_FEATURE_MSR)) {
+        return 0;
+    }
+    
+    unsigned long long cap = rdmsr(MSR_MTRR_CAP);
+    int count = cap & 0xFF;
+    if (!(cap & (1 << 10))) {
+        return 0;
+    }
+    
+    unsigned int length = PAGE_SIZE;
+    while (length && (length < size || (base & (length - 1)) + size > length)) {
+        length <<= 1;
+    }
+    if (!length) {
+        return 0;
+    }
+    base &= ~(length - 1);
+    
+    int slot = -1;
+    for (int i = 0; i < count; i++) {
+        if (!(rdmsr(MSR_MTRR_PHYSMASK0 + 2 * i) & (1 << 11))) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        return 0;
+    }
+    
+    unsigned long long address_mask = (1ULL << physical_address_bits()) - 1;
+    unsigned long long mask = ~((unsigned long long)length - 1) & address_mask & ~0xFFFULL;
+    
+    // Documented update sequence: caches off and flushed, MTRRs disabled
+    // while the pair is written
+    unsigned int cr0;
+    unsigned int flags = irq_save();
+    __asm__ __volatile__("mov %%cr0, %0" : "=r"(cr0));
+    __asm__ __volatile__("mov %0, %%cr0" : : "r"((cr0 | (1 << 30)) & ~(1u << 29)) : "memory");
+    flush_caches();
+    flush_tlb();
+    
+    unsigned long long def_type = rdmsr(MSR_MTRR_DEF_TYPE);
+    wrmsr(MSR_MTRR_DEF_TYPE, def_type & ~(1ULL << 11));
+    wrmsr(MSR_MTRR_PHYSBASE0 + 2 * slot, base | MEMTYPE_WC);
+    wrmsr(MSR_MTRR_PHYSMASK0 + 2 * slot, mask | (1 << 11));
+    wrmsr(MSR_MTRR_DEF_TYPE, def_type);
+    
+    flush_caches();
+    flush_tlb();
+    __asm__ __volatile__("mov %0, %%cr0" : : "r"(cr0) : "memory");
+    irq_restore(flags);
+    return 1;
+}
+
+// Make a physical range (e.g. the linear framebuffer) write-combining:
+// through PAT on its 4 MB pages when paging is on, else with an MTRR.
+// Whole 4 MB pages are affected, so the range should be device memory.
+int paging_map_wc(unsigned int base, unsigned int size) {
+    if (size == 0) {
+        return WC_NONE;
+    }
+    
+    if (paging_on && pat_ready && base >= LARGE_PAGE_SIZE) {
+        unsigned int first = base / LARGE_PAGE_SIZE;
+        unsigned int last = (base + size - 1) / LARGE_PAGE_SIZE;
+        for (unsigned int i = first; i <= last; i++) {
+            page_directory[i] = (page_directory[i] & ~(PAGE_PWT | PAGE_PCD)) | PAGE_WC;
+            __asm__ __volatile__("invlpg (%0)" : : "r"(i * LARGE_PAGE_SIZE) : "memory");
+        }
+        return WC_PAT;
+    }
+    
+    if (mtrr_set_wc(base, size)) {
+        return WC_MTRR;
+    }
+    return WC_NONE;
+}
+
+// Make a physical range (device registers) uncacheable. Like
+// paging_map_wc(), whole 4 MB pages are affected. Without paging the
+// MTRRs already cover such ranges as UC.
+int paging_map_uc(unsigned int base, unsigned int size) {
+    if (size == 0 || base < LARGE_PAGE_SIZE) {
+        return 0;
+    }
+    if (!paging_on) {
+        return 1;
+    }
+    
+    unsigned int first = base / LARGE_PAGE_SIZE;
+    unsigned int last = (base + size - 1) / LARGE_PAGE_SIZE;
+    for (unsigned int i = first; i <= last; i++) {
+        page_directory[i] |= PAGE_PWT | PAGE_PCD;
+        __asm__ __volatile__("invlpg (%0)" : : "r"(i * LARGE_PAGE_SIZE) : "memory");
+    }
+    return 1;
+}
@@ -0,0 +1,271 @@
+#include "../Lib/include/pmm.h"
+#include "../Lib/include/cpu.h"
+
+// Buddy allocator over the usable E820 ranges. Free blocks are linked
+// through their own first bytes (memory is identity-mapped), one list
+// per order, so allocating or freeing a frame is a list push/pop plus at
+// most PMM_MAX_ORDER split or merge steps.
+typedef struct free_block {
+    struct free_block* next;
+    struct free_block* prev;
+} free_block_t;
+
+// Per-frame state: FRAME_FREE | order on the first frame of a free block,
+// 0 everywhere else (allocated, reserved or inside a block)
+#define FRAME_FREE 0x80
+
+// Frames below this stay reserved: BIOS data, boot info, kernel image,
+// boot stack and the VGA/ROM hole
+#define PMM_LOW_LIMIT 0x100000
+
+// Highest address managed (32-bit physical addresses only)
+#define PMM_HIGH_LIMIT 0xFFFFF000ULL
+
+static free_block_t* free_lists[PMM_MAX_ORDER + 1];
+static unsigned int free_counts[PMM_MAX_ORDER + 1];
+static unsigned char* frame_state = 0;
+static unsigned int frame_count = 0;
+static unsigned int total_frames = 0;
+static unsigned int free_frames = 0;
+
+// End of the kernel image and its zero-initialized data (from the linker)
+extern char _end[];
+
+static inline unsigned int frame_index(unsigned int addr) {
+    return addr / FRAME_SIZE;
+}
+
+static void list_push(int order, unsigned int addr) {
+    free_block_t* block = (free_block_t*)addr;
+    block->prev = 0;
+    block->next = free_lists[order];
+    if (block->next) {
+        block->next->prev = block;
+    }
+    free_lists[order] = block;
+    free_counts[order]++;
+    frame_state[frame_index(addr)] = FRAME_FREE | order;
+}
+
+static void list_remove(int order, unsigned int addr) {
+    free_block_t* block = (free_block_t*)addr;
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        free_lists[order] = block->next;
+    }
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+    free_counts[order]--;
+    frame_state[frame_index(addr)] = 0;
+}
+
+// Return a block, merging it with its buddy while the buddy is free
+static void free_block(unsigned int addr, int order) {
+    free_frames += 1u << order;
+    
+    while (order < PMM_MAX_ORDER) {
+        unsigned int buddy = addr ^ (FRAME_SIZE << order);
+        unsigned int index = frame_index(buddy);
+        if (index >= frame_count || frame_state[index] != (FRAME_FREE | order)) {
+            break;
+        }
+        list_remove(order, buddy);
+        addr &= ~(FRAME_SIZE << order);
+        order++;
+    }
+    list_push(order, addr);
+}
+
+// Hand a free physical range to the allocator as maximal aligned blocks
+static void add_range(unsigned int start, unsigned int end) {
+    while (start < end) {
+        int order = PMM_MAX_ORDER;
+        while (order > 0 &&
+               ((start & ((FRAME_SIZE << order) - 1)) || end - start < (FRAME_SIZE << order))) {
+            order--;
+        }
+        total_frames += 1u << order;
+        free_block(start, order);
+        start += FRAME_SIZE << order;
+    }
+}
+
+// Clip an E820 entry to whole frames within [low, PMM_HIGH_LIMIT)
+static int usable_range(const e820_entry_t* entry, unsigned int low,
+                        unsigned int* start, unsigned int* end) {
+    unsigned long long base = entry->base;
+    unsigned long long top = entry->base + entry->length;
+    
+    if (entry->type != E820_USABLE || !(entry->attributes & 1)) {
+        return 0;
+    }
+    if (base < low) base = low;
+    if (top > PMM_HIGH_LIMIT) top = PMM_HIGH_LIMIT;
+    base = (base + FRAME_SIZE - 1) & ~(unsigned long long)(FRAME_SIZE - 1);
+    top &= ~(unsigned long long)(FRAME_SIZE - 1);
+    if (base >= top) {
+        return 0;
+    }
+    *start = (unsigned int)base;
+    *end = (unsigned int)top;
+    return 1;
+}
+
+// Build the allocator from the boot memory map (returns 0 without one)
+int pmm_init(const boot_info_t* info) {
+    unsigned int start, end;
+    unsigned int low = PMM_LOW_LIMIT;
+    
+    for (int i = 0; i <= PMM_MAX_ORDER; i++) {
+        free_lists[i] = 0;
+        free_counts[i] = 0;
+    }
+    frame_count = 0;
+    total_frames = 0;
+    free_frames = 0;
+    
+    if (!info || info->mmap_count == 0) {
+        return 0;
+    }
+    if ((unsigned int)_end > low) {
+        low = ((unsigned int)_end + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1);
+    }
+    
+    // Frames covered: up to the end of the highest usable range
+    unsigned int top = 0;
+    for (unsigned int i = 0; i < info->mmap_count && i < BOOT_MMAP_MAX; i++) {
+        if (usable_range(&info->mmap[i], low, &start, &end) && end > top) {
+            top = end;
+        }
+    }
+    frame_count = top / FRAME_SIZE;
+    
+    // The state table goes at the start of the first usable range that
+    // can hold it; that range then starts after it
+    unsigned int table = 0;
+    for (unsigned int i = 0; i < info->mmap_count && i < BOOT_MMAP_MAX; i++) {
+        if (usable_range(&info->mmap[i], low, &start, &end) && end - start >= frame_count) {
+            table = start;
+            break;
+        }
+    }
+    if (!table) {
+        frame_count = 0;
+        return 0;
+    }
+    frame_state = (unsigned char*)table;
+    for (unsigned int i = 0; i < frame_count; i++) {
+        frame_state[i] = 0;
+    }
+    unsigned int table_end = (table + frame_count + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1);
+    
+    for (unsigned int i = 0; i < info->mmap_count && i < BOOT_MMAP_MAX; i++) {
+        if (!usable_range(&info->mmap[i], low, &start, &end)) {
+            continue;
+        }
+        if (start <= table && table < end) {
+            start = table_end;
+        }
+        if (start < end) {
+            add_range(start, end);
+        }
+    }
+    return 1;
+}
+
+// Allocate 2^order contiguous frames aligned to their size (0 on failure)
+unsigned int pmm_alloc(int order) {
+    int found = order;
+    
+    if (order < 0 || order > PMM_MAX_ORDER) {
+        return 0;
+    }
+    
+    // Threads and interrupt handlers share the free lists
+    unsigned int flags = irq_save();
+    while (found <= PMM_MAX_ORDER && !free_lists[found]) {
+        found++;
+    }
+    if (found > PMM_MAX_ORDER) {
+        irq_restore(flags);
+        return 0;
+    }
+    
+    unsigned int addr = (unsigned int)free_lists[found];
+    list_remove(found, addr);
+    
+    // Split, returning the upper halves
+    while (found > order) {
+        found--;
+        list_push(found, addr + (FRAME_SIZE << found));
+    }
+    free_frames -= 1u << order;
+    irq_restore(flags);
+    return addr;
+}
+
+// Free a block from pmm_alloc
+void pmm_free(unsigned int addr, int order) {
+    if (addr == 0 || order < 0 || order > PMM_MAX_ORDER ||
+        frame_index(addr) + (1u << order) > frame_count) {
+        return;
+    }
+    
+    unsigned int flags = irq_save();
+    free_block(addr, order);
+    irq_restore(flags);
+}
+
+// Allocate exactly count contiguous frames: the surplus of the covering
+// power-of-two block goes straight back to the free lists
+unsigned int pmm_alloc_pages(unsigned int count) {
+    int order = 0;
+    
+    if (count == 0) {
+        return 0;
+    }
+    while ((1u << order) < count) {
+        order++;
+    }
+    
+    unsigned int addr = pmm_alloc(order);
+    if (addr) {
+        pmm_free_pages(addr + count * FRAME_SIZE, (1u << order) - count);
+    }
+    return addr;
+}
+
+// Free count contiguous frames (any alignment) as maximal aligned blocks
+void pmm_free_pages(unsigned int addr, unsigned int count) {
+    while (count > 0) {
+        int order = 0;
+        while (order < PMM_MAX_ORDER &&
+               !(addr & (FRAME_SIZE << order)) && (2u << order) <= count) {
+            order++;
+        }
+        pmm_free(addr, order);
+        addr += FRAME_SIZE << order;
+        count -= 1u << order;
+    }
+}
+
+// Smallest order whose block holds bytes
+int pmm_order_for(unsigned int bytes) {
+    int order = 0;
+    while (order <= PMM_MAX_ORDER && (FRAME_SIZE << order) < bytes) {
+        order++;
+    }
+    return order;
+}
+
+// Report memory statistics
+void pmm_get_stats(pmm_stats_t* stats) {
+    stats->total = total_frames;
+    stats->free = free_frames;
+    stats->reserved = frame_count - total_frames;
+    for (int i = 0; i <= PMM_MAX_ORDER; i++) {
+        stats->free_blocks[i] = free_counts[i];
+    }
+}
@@ -0,0 +1,265 @@
+#include "../Lib/include/smp.h"
+#include "../Lib/include/acpi.h"
+#include "../Lib/include/apic.h"
+#include "../Lib/include/cpu.h"
+#include "../Lib/include/idt.h"
+#include "../Lib/include/paging.h"
+#include "../Lib/include/pmm.h"
+#include "../Lib/include/thread.h"
+#include "../Lib/include/timer.h"
+
+// Parameter block at the end of the trampoline
+typedef struct {
+    unsigned short pad;
+    unsigned short gdt_limit;
+    unsigned int gdt_base;
+    unsigned int stack;
+    unsigned int entry;
+} __attribute__((packed)) trampoline_params_t;
+
+extern unsigned char smp_trampoline_start[];
+extern unsigned char smp_trampoline_params[];
+extern unsigned char smp_trampoline_end[];
+
+// GDT pointer for lgdt
+typedef struct {
+    unsigned short limit;
+    unsigned int base;
+} __attribute__((packed)) gdt_ptr_t;
+
+// Flat 4 GB descriptors: ring 0 code and data
+#define GDT_CODE 0x00CF9A000000FFFFULL
+#define GDT_DATA 0x00CF92000000FFFFULL
+
+// How long an application processor gets to come up
+#define STARTUP_TIMEOUT_MS 100
+
+static cpu_t cpus[SMP_MAX_CPUS];
+static int cpu_count = 1;
+
+// CPU the trampoline is currently starting
+static cpu_t* volatile booting = 0;
+
+// Posted job: application processors run parts 1..count-1 of fn when
+// work_generation moves, the poster runs part 0
+static smp_work_fn volatile work_fn = 0;
+static void* volatile work_arg = 0;
+static volatile int work_count = 0;
+static volatile unsigned int work_generation = 0;
+static volatile int work_remaining = 0;
+static volatile int work_busy = 0;
+
+// Busy-wait (timer_init() must have run)
+static void delay_us(unsigned int us) {
+    unsigned long long end = timer_now_ns() + (unsigned long long)us * 1000;
+    while (timer_now_ns() < end) {
+        cpu_pause();
+    }
+}
+
+static void gdt_fill(cpu_t* cpu) {
+    cpu->gdt[0] = 0;
+    cpu->gdt[1] = GDT_CODE;
+    cpu->gdt[2] = GDT_DATA;
+}
+
+// Switch the boot CPU to its own GDT and reload every segment register
+// (application processors load theirs in the trampoline)
+static void gdt_load(cpu_t* cpu) {
+    gdt_ptr_t gdtr;
+    
+    gdt_fill(cpu);
+    gdtr.limit = sizeof(cpu->gdt) - 1;
+    gdtr.base = (unsigned int)cpu->gdt;
+    
+    __asm__ __volatile__(
+        "lgdt %0\n\t"
+        "ljmp $0x08, $1f\n\t"
+        "1:\n\t"
+        "mov $0x10, %%ax\n\t"
+        "mov %%ax, %%ds\n\t"
+        "mov %%ax, %%es\n\t"
+        "mov %%ax, %%fs\n\t"
+        "mov %%ax, %%gs\n\t"
+        "mov %%ax, %%ss\n\t"
+        : : "m"(gdtr) : "eax", "memory");
+}
+
+// Application processor loop: sleep until work is posted, run our part
+static void ap_work_loop(cpu_t* cpu) {
+    unsigned int seen = work_generation;
+    
+    while (1) {
+        // Check and halt with interrupts off; sti delays them until after
+        // hlt, so the IPI cannot slip in between
+        __asm__ __volatile__("cli");
+        if (work_generation == seen) {
+            __asm__ __volatile__("sti; hlt");
+            continue;
+        }
+        __asm__ __volatile__("sti");
+        
+        seen = work_generation;
+        barrier();
+        if (cpu->index < work_count) {
+            work_fn(work_arg, cpu->index, work_count);
+            cpu->work_runs++;
+            __asm__ __volatile__("lock decl %0" : "+m"(work_remaining) : : "memory");
+        }
+    }
+}
+
+// First C code on an application processor (on its own stack, paging
+// still off, segments from its GDT)
+static void ap_main() {
+    cpu_t* cpu = booting;
+    
+    paging_init_ap();
+    cpu_init_ap();
+    idt_load_cpu();
+    apic_enable_local();
+    
+    barrier();
+    cpu->online = 1;
+    ap_work_loop(cpu);
+}
+
+// Start one application processor; returns 1 once it reports online
+static int ap_start(cpu_t* cpu) {
+    trampoline_params_t* params = (trampoline_params_t*)
+        (SMP_TRAMPOLINE_ADDR + (smp_trampoline_params - smp_trampoline_start));
+    
+    cpu->stack = pmm_alloc_pages(SMP_STACK_FRAMES);
+    if (!cpu->stack) {
+        return 0;
+    }
+    gdt_fill(cpu);
+    cpu->online = 0;
+    
+    params->gdt_limit = sizeof(cpu->gdt) - 1;
+    params->gdt_base = (unsigned int)cpu->gdt;
+    params->stack = cpu->stack + SMP_STACK_FRAMES * FRAME_SIZE;
+    params->entry = (unsigned int)ap_main;
+    booting = cpu;
+    barrier();
+    
+    // INIT, then up to two STARTUP IPIs (the second only if the first
+    // was missed, as the MP specification allows)
+    apic_send_init(cpu->apic_id);
+    delay_us(10000);
+    for (int attempt = 0; attempt < 2 && !cpu->online; attempt++) {
+        apic_send_startup(cpu->apic_id, SMP_TRAMPOLINE_ADDR);
+        delay_us(200);
+    }
+    
+    unsigned int start = timer_now_ms();
+    while (!cpu->online && timer_now_ms() - start < STARTUP_TIMEOUT_MS) {
+        cpu_pause();
+    }
+    if (!cpu->online) {
+        pmm_free_pages(cpu->stack, SMP_STACK_FRAMES);
+        cpu->stack = 0;
+        return 0;
+    }
+    return 1;
+}
+
+// Give the boot CPU its per-CPU GDT and start every other enabled CPU
+// the MADT lists. Needs apic_init() and timer_init(). Returns the
+// number of CPUs online.
+int smp_init() {
+    cpu_t* bsp = &cpus[0];
+    
+    bsp->index = 0;
+    bsp->apic_id = apic_active() ? apic_id() : 0;
+    bsp->online = 1;
+    gdt_load(bsp);
+    
+    // Application processors copy the boot CPU's SSE setup as they
+    // start, and the graphics work they share uses it
+    cpu_enable_sse();
+    
+    const acpi_madt_t* madt = acpi_madt();
+    if (!apic_active() || !madt || madt->cpu_count < 2) {
+        return cpu_count;
+    }
+    
+    // Trampoline into low memory
+    unsigned char* dst = (unsigned char*)SMP_TRAMPOLINE_ADDR;
+    for (unsigned char* src = smp_trampoline_start; src < smp_trampoline_end; src++) {
+        *dst++ = *src;
+    }
+    
+    for (int i = 0; i < madt->cpu_count && cpu_count < SMP_MAX_CPUS; i++) {
+        if (madt->cpu_apic_ids[i] == bsp->apic_id) {
+            continue;
+        }
+        cpu_t* cpu = &cpus[cpu_count];
+        cpu->index = cpu_count;
+        cpu->apic_id = madt->cpu_apic_ids[i];
+        if (ap_start(cpu)) {
+            cpu_count++;
+        }
+    }
+    booting = 0;
+    return cpu_count;
+}
+
+// Number of CPUs online
+int smp_cpu_count() {
+    return cpu_count;
+}
+
+// Per-CPU data by index (0 if out of range)
+cpu_t* smp_cpu(int index) {
+    return index >= 0 && index < cpu_count ? &cpus[index] : 0;
+}
+
+// Per-CPU data of the running CPU
+cpu_t* cpu_current() {
+    if (cpu_count > 1) {
+        unsigned int id = apic_id();
+        for (int i = 1; i < cpu_count; i++) {
+            if (cpus[i].apic_id == id) {
+                return &cpus[i];
+            }
+        }
+    }
+    return &cpus[0];
+}
+
+// Run fn(arg, index, count) once for each index below count, one index
+// per online CPU, and return when all parts are done. The caller runs
+// part 0 itself. Call from thread context on the boot CPU only.
+void smp_run(smp_work_fn fn, void* arg) {
+    if (cpu_count < 2) {
+        fn(arg, 0, 1);
+        return;
+    }
+    
+    // One job at a time; another thread's job finishes first
+    unsigned int flags = irq_save();
+    while (work_busy) {
+        irq_restore(flags);
+        thread_yield();
+        flags = irq_save();
+    }
+    work_busy = 1;
+    irq_restore(flags);
+    
+    work_fn = fn;
+    work_arg = arg;
+    work_count = cpu_count;
+    work_remaining = cpu_count - 1;
+    barrier();
+    work_generation++;
+    apic_broadcast_ipi(SMP_WORK_VECTOR);
+    
+    fn(arg, 0, cpu_count);
+    cpus[0].work_runs++;
+    while (work_remaining) {
+        cpu_pause();
+    }
+    
+    work_busy = 0;
+}
@@ -0,0 +1,57 @@
+; Application processor startup. smp.c copies this block to
+; SMP_TRAMPOLINE_ADDR and fills in the parameters at its end; a STARTUP
+; IPI then starts the CPU here in real mode with CS = address >> 4.
+; Addresses are computed from the copy's location, not the link address.
+
+TRAMPOLINE_ADDR equ 0x91000         ; SMP_TRAMPOLINE_ADDR in smp.h
+
+global smp_trampoline_start
+global smp_trampoline_params
+global smp_trampoline_end
+
+BITS 16
+smp_trampoline_start:
+    cli
+    cld
+    mov ax, cs
+    mov ds, ax
+    
+    ; The started CPU's own GDT (flat, same selectors as the boot CPU)
+    o32 lgdt [tramp_gdtr - smp_trampoline_start]
+    
+    mov eax, cr0
+    or eax, 1
+    mov cr0, eax
+    
+    jmp dword 0x08:(TRAMPOLINE_ADDR + tramp_pm - smp_trampoline_start)
+
+BITS 32
+tramp_pm:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+    
+    mov esp, [TRAMPOLINE_ADDR + tramp_stack - smp_trampoline_start]
+    mov eax, [TRAMPOLINE_ADDR + tramp_entry - smp_trampoline_start]
+    call eax
+    
+.halt:
+    cli
+    hlt
+    jmp .halt
+
+; Parameters (trampoline_params_t in smp.c)
+align 4
+smp_trampoline_params:
+    dw 0
+tramp_gdtr:
+    dw 0                            ; Limit
+    dd 0                            ; Base
+tramp_stack:
+    dd 0
+tramp_entry:
+    dd 0
+smp_trampoline_end:
@@ -0,0 +1,105 @@
+#include "../Lib/include/softirq.h"
+#include "../Lib/include/thread.h"
+#include "../Lib/include/timer.h"
+#include "../Lib/include/cpu.h"
+
+typedef struct {
+    softirq_fn fn;
+    void* data;
+    unsigned long long raised_at;  // First raise since the last run (0: none)
+    softirq_stats_t stats;
+} softirq_t;
+
+static softirq_t softirqs[SOFTIRQ_COUNT];
+
+// Bit n set: softirq n raised and not yet run
+static volatile unsigned int pending = 0;
+
+// Worker thread, 0 until softirq_init()
+static thread_t* worker = 0;
+
+// Set the handler for a softirq
+void softirq_register(int nr, softirq_fn fn, void* data) {
+    if (nr < 0 || nr >= SOFTIRQ_COUNT) {
+        return;
+    }
+    
+    unsigned int flags = irq_save();
+    softirqs[nr].fn = fn;
+    softirqs[nr].data = data;
+    irq_restore(flags);
+}
+
+// Mark a softirq pending and wake the worker; called from IRQ context
+void softirq_raise(int nr) {
+    if (nr < 0 || nr >= SOFTIRQ_COUNT) {
+        return;
+    }
+    
+    unsigned int flags = irq_save();
+    softirq_t* softirq = &softirqs[nr];
+    softirq->stats.raised++;
+    if (!(pending & (1u << nr))) {
+        softirq->raised_at = timer_now_ns();
+        pending |= 1u << nr;
+    }
+    if (worker) {
+        thread_wake(worker);
+    }
+    irq_restore(flags);
+}
+
+// Run every pending handler with interrupts enabled. The worker calls
+// this; code that polls before the scheduler runs may call it too.
+void softirq_run() {
+    while (pending) {
+        unsigned int flags = irq_save();
+        unsigned int mask = pending;
+        pending = 0;
+        irq_restore(flags);
+        
+        for (int nr = 0; nr < SOFTIRQ_COUNT; nr++) {
+            if (!(mask & (1u << nr))) {
+                continue;
+            }
+            
+            softirq_t* softirq = &softirqs[nr];
+            unsigned long long delay = timer_now_ns() - softirq->raised_at;
+            if (delay > softirq->stats.max_delay_ns) {
+                softirq->stats.max_delay_ns = delay;
+            }
+            softirq->stats.runs++;
+            if (softirq->fn) {
+                softirq->fn(softirq->data);
+            }
+        }
+    }
+}
+
+// Worker: sleeps until something is raised
+static void softirq_thread(void* arg) {
+    while (1) {
+        unsigned int flags = irq_save();
+        while (!pending) {
+            thread_block();
+        }
+        irq_restore(flags);
+        
+        softirq_run();
+    }
+}
+
+// Start the worker; needs sched_init(). It runs above every other
+// thread so deferred work still follows its interrupt closely.
+void softirq_init() {
+    worker = thread_create("softirqd", softirq_thread, 0, THREAD_PRIORITY_HIGH);
+}
+
+// Report counters for one softirq
+void softirq_get_stats(int nr, softirq_stats_t* stats) {
+    if (nr >= 0 && nr < SOFTIRQ_COUNT) {
+        unsigned int flags = irq_save();
+        *stats = softirqs[nr].stats;
+        irq_restore(flags);
+    }
+}
@@ -0,0 +1,411 @@
+#include "../Lib/include/thread.h"
+#include "../Lib/include/isr.h"
+#include "../Lib/include/cpu.h"
+#include "../Lib/include/heap.h"
+#include "../Lib/include/pmm.h"
+#include "../Lib/include/timer.h"
+
+// Kernel threads. A thread that is not running is represented by the
+// register frame irq_common_stub pushed on its stack when it was last
+// interrupted (or a fake one for a new thread). sched_switch() returns
+// the frame to resume and the stub loads it into esp before popping,
+// so a context switch is just returning a different pointer.
+
+// Run queues, one FIFO per priority level
+static thread_t* run_head[THREAD_PRIORITIES];
+static thread_t* run_tail[THREAD_PRIORITIES];
+
+static thread_t* current = 0;
+static thread_t* all_threads = 0;
+
+// Dead threads whose stacks are freed by the idle loop (a thread
+// cannot free the stack it is still running on)
+static thread_t* zombies = 0;
+
+// The context kernel_main runs in; keeps the boot stack
+static thread_t boot_thread;
+
+static volatile int need_resched = 0;
+
+// Set while sched_switch() halts for something to become ready
+static volatile int sched_waiting = 0;
+static int next_id = 0;
+
+// FPU/SSE state is saved eagerly on every switch; new threads start
+// from the state captured at sched_init()
+static int save_fpu = 0;
+static unsigned char fx_initial[512] __attribute__((aligned(16)));
+
+static void copy_name(char* dst, const char* src) {
+    int i = 0;
+    while (src[i] && i < THREAD_NAME_LENGTH - 1) {
+        dst[i] = src[i];
+        i++;
+    }
+    dst[i] = '\0';
+}
+
+// Append a thread to the tail of its level
+static void run_enqueue(thread_t* thread) {
+    int p = thread->priority;
+    thread->next = 0;
+    if (run_tail[p]) {
+        run_tail[p]->next = thread;
+    } else {
+        run_head[p] = thread;
+    }
+    run_tail[p] = thread;
+}
+
+// Pop the first thread of the highest non-empty level
+static thread_t* run_dequeue() {
+    for (int p = 0; p < THREAD_PRIORITIES; p++) {
+        thread_t* thread = run_head[p];
+        if (thread) {
+            run_head[p] = thread->next;
+            if (!run_head[p]) {
+                run_tail[p] = 0;
+            }
+            thread->next = 0;
+            return thread;
+        }
+    }
+    return 0;
+}
+
+// Unlink a ready thread from its level
+static void run_remove(thread_t* thread) {
+    int p = thread->priority;
+    thread_t* prev = 0;
+    thread_t* t = run_head[p];
+    
+    while (t && t != thread) {
+        prev = t;
+        t = t->next;
+    }
+    if (!t) {
+        return;
+    }
+    if (prev) {
+        prev->next = t->next;
+    } else {
+        run_head[p] = t->next;
+    }
+    if (run_tail[p] == t) {
+        run_tail[p] = prev;
+    }
+    t->next = 0;
+}
+
+// Turn the running context into the first thread
+void sched_init() {
+    boot_thread.id = next_id++;
+    boot_thread.priority = THREAD_PRIORITY_NORMAL;
+    boot_thread.state = THREAD_RUNNING;
+    boot_thread.slice = THREAD_TIME_SLICE;
+    copy_name(boot_thread.name, "main");
+    
+    // Threads may use SSE (the blitters do), so its registers are part
+    // of the context
+    save_fpu = cpu_enable_sse();
+    if (save_fpu) {
+        __asm__ __volatile__("fxsave %0" : "=m"(fx_initial));
+    }
+    
+    unsigned int flags = irq_save();
+    boot_thread.all_next = all_threads;
+    all_threads = &boot_thread;
+    current = &boot_thread;
+    irq_restore(flags);
+}
+
+// Check whether threads are set up
+int sched_running() {
+    return current != 0;
+}
+
+// Account the tick to the running thread; called from the timer IRQ
+void sched_tick() {
+    if (!current) {
+        return;
+    }
+    current->run_ticks++;
+    if (--current->slice <= 0) {
+        need_resched = 1;
+    }
+}
+
+// Choose the frame to return to at the end of an interrupt: the
+// interrupted thread's own, unless it yielded, blocked or used up its
+// slice. Runs with interrupts disabled.
+struct registers* sched_switch(struct registers* regs) {
+    if (!current || sched_waiting) {
+        return regs;
+    }
+    if (regs->int_no != THREAD_YIELD_VECTOR && !need_resched) {
+        return regs;
+    }
+    need_resched = 0;
+    
+    thread_t* prev = current;
+    prev->context = regs;
+    if (prev->state == THREAD_RUNNING) {
+        prev->state = THREAD_READY;
+        run_enqueue(prev);
+    }
+    
+    // Nothing runnable, not even idle (prev blocked or exited before
+    // thread_idle()): halt until an interrupt makes a thread ready.
+    // Interrupts taken meanwhile return straight here, not to a thread.
+    thread_t* next = run_dequeue();
+    while (!next) {
+        sched_waiting = 1;
+        __asm__ __volatile__("sti; hlt; cli" : : : "memory");
+        sched_waiting = 0;
+        next = run_dequeue();
+    }
+    need_resched = 0;
+    next->state = THREAD_RUNNING;
+    next->slice = THREAD_TIME_SLICE;
+    
+    if (next != prev) {
+        if (save_fpu) {
+            __asm__ __volatile__("fxsave %0" : "=m"(prev->fx_state));
+            __asm__ __volatile__("fxrstor %0" : : "m"(next->fx_state));
+        }
+        current = next;
+    }
+    
+    if (prev->state == THREAD_DEAD) {
+        prev->next = zombies;
+        zombies = prev;
+    }
+    return next->context;
+}
+
+// First code a new thread runs
+static void thread_start() {
+    current->fn(current->arg);
+    thread_exit();
+}
+
+// Create a ready thread running fn(arg) (0 on failure)
+thread_t* thread_create(const char* name, thread_fn fn, void* arg, int priority) {
+    if (priority < 0 || priority >= THREAD_PRIORITIES) {
+        return 0;
+    }
+    
+    thread_t* thread = kzalloc(sizeof(thread_t));
+    unsigned int stack = pmm_alloc_pages(THREAD_STACK_FRAMES);
+    if (!thread || !stack) {
+        kfree(thread);
+        pmm_free_pages(stack, THREAD_STACK_FRAMES);
+        return 0;
+    }
+    
+    copy_name(thread->name, name);
+    thread->stack = stack;
+    thread->fn = fn;
+    thread->arg = arg;
+    thread->priority = priority;
+    for (int i = 0; i < 512; i++) {
+        thread->fx_state[i] = fx_initial[i];
+    }
+    
+    // Fake interrupt frame at the top of the stack. An iret to the same
+    // ring pops eip, cs and eflags only, leaving esp at &useresp, which
+    // is placed so thread_start sees a 16-byte aligned call frame.
+    unsigned int entry_sp = stack + THREAD_STACK_FRAMES * FRAME_SIZE - 4;
+    struct registers* frame = (struct registers*)(entry_sp - (sizeof(struct registers) - 8));
+    frame->gs = frame->fs = frame->es = frame->ds = 0x10;
+    frame->edi = frame->esi = frame->ebp = frame->esp = 0;
+    frame->ebx = frame->edx = frame->ecx = frame->eax = 0;
+    frame->int_no = frame->err_code = 0;
+    frame->eip = (unsigned int)thread_start;
+    frame->cs = 0x08;
+    frame->eflags = 0x202;         // IF set
+    thread->context = frame;
+    
+    unsigned int flags = irq_save();
+    thread->id = next_id++;
+    thread->state = THREAD_READY;
+    thread->all_next = all_threads;
+    all_threads = thread;
+    run_enqueue(thread);
+    if (current && priority < current->priority) {
+        need_resched = 1;
+    }
+    irq_restore(flags);
+    return thread;
+}
+
+// Get the running thread (0 before sched_init)
+thread_t* thread_current() {
+    return current;
+}
+
+// Move a thread to another level
+void thread_set_priority(thread_t* thread, int priority) {
+    if (priority < 0 || priority >= THREAD_PRIORITIES) {
+        return;
+    }
+    
+    unsigned int flags = irq_save();
+    if (thread->state == THREAD_READY) {
+        run_remove(thread);
+        thread->priority = priority;
+        run_enqueue(thread);
+    } else {
+        thread->priority = priority;
+    }
+    if (current && (thread == current || priority < current->priority)) {
+        need_resched = 1;
+    }
+    irq_restore(flags);
+}
+
+// Give the CPU to the next ready thread
+void thread_yield() {
+    __asm__ __volatile__("int %0" : : "i"(THREAD_YIELD_VECTOR) : "memory");
+}
+
+// End the running thread
+void thread_exit() {
+    irq_save();
+    current->state = THREAD_DEAD;
+    thread_yield();
+    
+    // Never resumed
+    while (1) {
+        __asm__ __volatile__("hlt");
+    }
+}
+
+// Sleep until thread_wake(). Callers check their condition and block
+// with interrupts disabled so a wakeup cannot slip in between.
+void thread_block() {
+    unsigned int flags = irq_save();
+    current->state = THREAD_BLOCKED;
+    while (current->state == THREAD_BLOCKED) {
+        thread_yield();
+    }
+    irq_restore(flags);
+}
+
+// Make a blocked thread ready; safe from interrupt handlers
+void thread_wake(thread_t* thread) {
+    unsigned int flags = irq_save();
+    if (thread->state == THREAD_BLOCKED) {
+        thread->state = THREAD_READY;
+        run_enqueue(thread);
+        if (current && thread->priority < current->priority) {
+            need_resched = 1;
+        }
+    }
+    irq_restore(flags);
+}
+
+// Timer callback for thread_sleep_ms
+static void sleep_expired(void* data) {
+    thread_wake((thread_t*)data);
+}
+
+// Block the running thread for at least ms milliseconds. The timer is
+// on this stack, so an early thread_wake() only blocks again: returning
+// while it is still in the wheel would leave the wheel pointing into a
+// dead frame.
+void thread_sleep_ms(unsigned int ms) {
+    timer_t timer;
+    timer.pending = 0;
+    
+    unsigned int flags = irq_save();
+    timer_add(&timer, ms, sleep_expired, current);
+    do {
+        thread_block();
+    } while (timer.pending);
+    irq_restore(flags);
+}
+
+// Free the stacks of exited threads
+static void reap_zombies() {
+    unsigned int flags = irq_save();
+    thread_t* dead = zombies;
+    zombies = 0;
+    
+    for (thread_t* thread = dead; thread; thread = thread->next) {
+        thread_t** link = &all_threads;
+        while (*link != thread) {
+            link = &(*link)->all_next;
+        }
+        *link = thread->all_next;
+    }
+    irq_restore(flags);
+    
+    while (dead) {
+        thread_t* next = dead->next;
+        pmm_free_pages(dead->stack, THREAD_STACK_FRAMES);
+        kfree(dead);
+        dead = next;
+    }
+}
+
+// Become the idle thread: runs only when nothing else is ready
+void thread_idle() {
+    thread_set_priority(current, THREAD_PRIORITY_IDLE);
+    copy_name(current->name, "idle");
+    
+    while (1) {
+        reap_zombies();
+        __asm__ __volatile__("hlt");
+    }
+}
+
+// Copy up to max thread descriptions into out; returns the count
+int thread_list(thread_info_t* out, int max) {
+    int count = 0;
+    
+    unsigned int flags = irq_save();
+    for (thread_t* thread = all_threads; thread && count < max; thread = thread->all_next) {
+        out[count].id = thread->id;
+        out[count].priority = thread->priority;
+        out[count].state = thread->state;
+        out[count].run_ticks = thread->run_ticks;
+        copy_name(out[count].name, thread->name);
+        count++;
+    }
+    irq_restore(flags);
+    return count;
+}
+
+void wait_queue_init(wait_queue_t* queue) {
+    queue->head = 0;
+    queue->tail = 0;
+}
+
+// Block the running thread on queue until thread_wake_all()
+void thread_wait(wait_queue_t* queue) {
+    unsigned int flags = irq_save();
+    current->next = 0;
+    if (queue->tail) {
+        queue->tail->next = current;
+    } else {
+        queue->head = current;
+    }
+    queue->tail = current;
+    thread_block();
+    irq_restore(flags);
+}
+
+// Wake every thread waiting on queue
+void thread_wake_all(wait_queue_t* queue) {
+    unsigned int flags = irq_save();
+    thread_t* thread = queue->head;
+    queue->head = 0;
+    queue->tail = 0;
+    while (thread) {
+        thread_t* next = thread->next;
+        thread_wake(thread);
+        thread = next;
+    }
+    irq_restore(flags);
+}
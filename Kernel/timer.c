@@ -0,0 +1,231 @@
+#include "../Lib/include/timer.h"
+#include "../Lib/include/cpu.h"
+#include "../Lib/include/io.h"
+#include "../Lib/include/idt.h"
+#include "../Lib/include/isr.h"
+#include "../Lib/include/thread.h"
+#include "../Lib/include/apic.h"
+
+// PIT ports
+#define PIT_CHANNEL0 0x40
+#define PIT_CHANNEL2 0x42
+#define PIT_COMMAND  0x43
+#define PIT_GATE     0x61
+
+// TSC calibration window
+#define CALIBRATE_MS 50
+
+static volatile unsigned int ticks = 0;
+static unsigned int tick_hz = 0;
+static unsigned int ns_per_tick = 0;
+
+// TSC: cycles to nanoseconds as (cycles * tsc_mult) >> tsc_shift
+static unsigned long long tsc_hz = 0;
+static unsigned long long tsc_base = 0;
+static unsigned int tsc_mult = 0;
+static unsigned int tsc_shift = 0;
+
+static timer_t* wheel[TIMER_WHEEL_SLOTS];
+
+// Count TSC cycles over CALIBRATE_MS using PIT channel 2 in one-shot mode
+static unsigned long long calibrate_tsc() {
+    unsigned int count = PIT_FREQUENCY * CALIBRATE_MS / 1000;
+    
+    // Gate channel 2 on, speaker off
+    outb(PIT_GATE, (inb(PIT_GATE) & ~0x02) | 0x01);
+    
+    // Channel 2, low/high byte, mode 0 (output goes high at terminal count)
+    outb(PIT_COMMAND, 0xB0);
+    outb(PIT_CHANNEL2, count & 0xFF);
+    outb(PIT_CHANNEL2, count >> 8);
+    
+    unsigned long long start = rdtsc();
+    while (!(inb(PIT_GATE) & 0x20)) {
+    }
+    unsigned long long cycles = rdtsc() - start;
+    
+    return div64_32(cycles * PIT_FREQUENCY, count);
+}
+
+// Unlink a timer from its wheel slot
+static void wheel_remove(timer_t* timer) {
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        wheel[timer->expires % TIMER_WHEEL_SLOTS] = timer->next;
+    }
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+    timer->pending = 0;
+}
+
+// Tick: run the timers in this tick's slot that are due
+static void timer_irq(struct registers* regs) {
+    unsigned int now = ++ticks;
+    timer_t* timer = wheel[now % TIMER_WHEEL_SLOTS];
+    
+    while (timer) {
+        timer_t* next = timer->next;
+        if ((int)(timer->expires - now) <= 0) {
+            wheel_remove(timer);
+            timer->fn(timer->data);
+        }
+        timer = next;
+    }
+    
+    sched_tick();
+}
+
+// Start the tick at hz and calibrate the TSC against the PIT
+void timer_init(unsigned int hz) {
+    if (hz < 19) hz = 19;
+    if (hz > PIT_FREQUENCY) hz = PIT_FREQUENCY;
+    
+    unsigned int divisor = (PIT_FREQUENCY + hz / 2) / hz;
+    tick_hz = hz;
+    ns_per_tick = div64_32((unsigned long long)divisor * 1000000000ULL, PIT_FREQUENCY);
+    
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        wheel[i] = 0;
+    }
+    
+    // The TSC only counts time when it runs at a fixed rate; without one
+    // the clock falls back to whole ticks
+    if (cpu_has(CPU_FEATURE_TSC)) {
+        tsc_hz = calibrate_tsc();
+        
+        // Largest shift that keeps the multiplier in 32 bits
+        tsc_shift = 32;
+        while (tsc_shift > 0 && (1000000000ULL << tsc_shift) >> 32 >= tsc_hz) {
+            tsc_shift--;
+        }
+        
+        // div64_32 takes a 32-bit divisor: scale both sides down past 4 GHz
+        unsigned long long scaled_ns = 1000000000ULL << tsc_shift;
+        unsigned long long scaled_hz = tsc_hz;
+        while (scaled_hz >> 32) {
+            scaled_hz >>= 1;
+            scaled_ns >>= 1;
+        }
+        tsc_mult = div64_32(scaled_ns, (unsigned int)scaled_hz);
+        tsc_base = rdtsc();
+    }
+    
+    irq_install_handler(0, timer_irq);
+    
+    // With an APIC the tick comes from the local APIC timer (no port
+    // I/O per tick, and every CPU has one); the PIT stays masked
+    if (apic_timer_start(hz)) {
+        ns_per_tick = 1000000000 / hz;
+        return;
+    }
+    
+    // Channel 0, low/high byte, mode 2 (rate generator)
+    outb(PIT_COMMAND, 0x34);
+    outb(PIT_CHANNEL0, divisor & 0xFF);
+    outb(PIT_CHANNEL0, divisor >> 8);
+    
+    irq_unmask(0);
+}
+
+// Tick rate
+unsigned int timer_hz() {
+    return tick_hz;
+}
+
+// Ticks since timer_init()
+unsigned int timer_ticks() {
+    return ticks;
+}
+
+// Calibrated TSC frequency (0 without a TSC)
+unsigned long long timer_tsc_hz() {
+    return tsc_hz;
+}
+
+// Convert TSC cycles to nanoseconds
+unsigned long long timer_cycles_to_ns(unsigned long long cycles) {
+    unsigned long long low = (cycles & 0xFFFFFFFF) * tsc_mult;
+    unsigned long long high = (cycles >> 32) * tsc_mult;
+    return (high << (32 - tsc_shift)) + (low >> tsc_shift);
+}
+
+// Monotonic time since timer_init() in nanoseconds
+unsigned long long timer_now_ns() {
+    if (tsc_mult) {
+        return timer_cycles_to_ns(rdtsc() - tsc_base);
+    }
+    return (unsigned long long)ticks * ns_per_tick;
+}
+
+// Monotonic time in milliseconds
+unsigned int timer_now_ms() {
+    return div64_32(timer_now_ns(), 1000000);
+}
+
+// Call fn(data) once, delay_ms from now (rounded up to whole ticks).
+// The timer must stay valid until it fires or is cancelled.
+void timer_add(timer_t* timer, unsigned int delay_ms, timer_fn fn, void* data) {
+    unsigned int delay = div64_32((unsigned long long)delay_ms * tick_hz + 999, 1000);
+    if (delay == 0) {
+        delay = 1;
+    }
+    
+    unsigned int flags = irq_save();
+    if (timer->pending) {
+        wheel_remove(timer);
+    }
+    timer->fn = fn;
+    timer->data = data;
+    timer->expires = ticks + delay;
+    timer->pending = 1;
+    
+    timer_t** slot = &wheel[timer->expires % TIMER_WHEEL_SLOTS];
+    timer->prev = 0;
+    timer->next = *slot;
+    if (timer->next) {
+        timer->next->prev = timer;
+    }
+    *slot = timer;
+    irq_restore(flags);
+}
+
+// Stop a pending timer (returns 0 if it already fired)
+int timer_cancel(timer_t* timer) {
+    unsigned int flags = irq_save();
+    int pending = timer->pending;
+    if (pending) {
+        wheel_remove(timer);
+    }
+    irq_restore(flags);
+    return pending;
+}
+
+static void sleep_wake(void* data) {
+    *(volatile int*)data = 1;
+}
+
+// Sleep for at least ms milliseconds: blocks the calling thread once
+// the scheduler runs, before that halts between interrupts
+void sleep_ms(unsigned int ms) {
+    volatile int done = 0;
+    timer_t timer;
+    
+    // No tick yet: nothing would ever wake us
+    if (!tick_hz) {
+        return;
+    }
+    
+    // Let other threads run meanwhile
+    if (sched_running()) {
+        thread_sleep_ms(ms);
+        return;
+    }
+    
+    timer.pending = 0;
+    timer_add(&timer, ms, sleep_wake, (void*)&done);
+    while (!done) {
+        __asm__ __volatile__("hlt");
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef ACPI_H
+#define ACPI_H
+
+// Limits on what is kept from the MADT
+#define ACPI_MAX_CPUS    16
+#define ACPI_MAX_IOAPICS 4
+#define ACPI_ISA_IRQS    16
+
+// Interrupt source override flags (MPS INTI flags)
+#define ACPI_POLARITY_MASK    0x03
+#define ACPI_POLARITY_LOW     0x03
+#define ACPI_TRIGGER_MASK     0x0C
+#define ACPI_TRIGGER_LEVEL    0x0C
+
+typedef struct {
+    unsigned char id;
+    unsigned int address;
+    unsigned int gsi_base;             // First global system interrupt
+} acpi_ioapic_t;
+
+// Interrupt controller layout from the MADT ("APIC" table)
+typedef struct {
+    unsigned int lapic_address;
+    int pcat_compat;                   // Legacy 8259 pair present
+    int cpu_count;                     // Enabled processors
+    unsigned char cpu_apic_ids[ACPI_MAX_CPUS];
+    int ioapic_count;
+    acpi_ioapic_t ioapics[ACPI_MAX_IOAPICS];
+    unsigned int isa_gsi[ACPI_ISA_IRQS];       // ISA IRQ -> GSI
+    unsigned short isa_flags[ACPI_ISA_IRQS];   // Override flags (0: ISA default)
+} acpi_madt_t;
+
+// Function prototypes
+int acpi_init();
+const acpi_madt_t* acpi_madt();
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef APIC_H
+#define APIC_H
+
+// Vectors beyond the ISA range (32-47) and the yield vector (48)
+#define LAPIC_TIMER_VECTOR    64
+#define LAPIC_SPURIOUS_VECTOR 127      // Low four bits must be set
+
+// Function prototypes
+int apic_init();
+void apic_enable_local();
+int apic_active();
+unsigned int apic_id();
+void apic_eoi();
+void ioapic_mask(int irq);
+void ioapic_unmask(int irq);
+int apic_timer_start(unsigned int hz);
+void apic_send_init(unsigned int id);
+void apic_send_startup(unsigned int id, unsigned int address);
+void apic_send_ipi(unsigned int id, int vector);
+void apic_broadcast_ipi(int vector);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Kernel microbenchmarks. Each entry of the registry times one
+// operation (a fill, a glyph, a scroll, an interrupt round trip) with
+// the TSC over a fixed number of iterations. Drawing benchmarks work
+// in a fixed screen region and hash it once presented, so a change to
+// a drawing routine can be checked to leave the pixels as they were.
+
+// Port of QEMU's isa-debug-exit device (-device isa-debug-exit,iobase=0xf4)
+#define BENCH_EXIT_PORT 0xF4
+
+typedef struct {
+    const char* name;
+    unsigned int iterations;
+    unsigned int min_cycles;
+    unsigned int avg_cycles;
+    int hashed;                    // 0 if the benchmark draws nothing
+    unsigned int hash;             // FNV-1a of the region's pixels
+} bench_result_t;
+
+// Function prototypes
+int bench_count();
+int bench_run(int index, bench_result_t* result);
+void bench_exit(int code);
+
+#endif
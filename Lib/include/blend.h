@@ -0,0 +1,46 @@
+#ifndef BLEND_H
+#define BLEND_H
+
+#include "graphics.h"
+
+// Premultiplied pixels: color channels already scaled by alpha, alpha kept
+// in the top byte. Compositing a premultiplied source over a destination is
+//     out = src + dst * (255 - a) / 255,   out alpha = 255
+// with x * y / 255 rounded exactly as ((x * y + 128) * 257) >> 16.
+// All kernels below are bit-identical to graphics_blend().
+
+// Exact rounded x * y / 255 for 0 <= x, y <= 255
+static inline unsigned int blend_mul255(unsigned int x, unsigned int y) {
+    return ((x * y + 128) * 257) >> 16;
+}
+
+// Convert a color to a premultiplied pixel
+static inline unsigned int blend_premultiply(color_t color) {
+    unsigned int a = color.a;
+    return (a << 24) | (blend_mul255(color.r, a) << 16) |
+           (blend_mul255(color.g, a) << 8) | blend_mul255(color.b, a);
+}
+
+// Kernel signatures
+typedef void (*blend_row_fn)(unsigned int* dst, unsigned int src, int count);
+typedef void (*blend_span_fn)(unsigned int* dst, const unsigned int* src, int count);
+typedef void (*blend_mask_fn)(unsigned int* dst, unsigned int src, unsigned int bits);
+
+// Function prototypes
+void blend_init();
+int blend_using_sse2();
+
+// Solid premultiplied color over count pixels
+void blend_row(unsigned int* dst, unsigned int src, int count);
+
+// Solid premultiplied color over a rectangle (pitch in pixels)
+void blend_rect(unsigned int* dst, int pitch, int width, int height, unsigned int src);
+
+// Per-pixel premultiplied sources over count pixels
+void blend_span(unsigned int* dst, const unsigned int* src, int count);
+
+// Solid premultiplied color over the pixels of one glyph row: pixel i
+// (0 <= i < count <= 8) is blended if bit (7 - i) of bits is set
+void blend_mask(unsigned int* dst, unsigned int src, unsigned int bits, int count);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+// Boot information left by boot_vesa.asm and stage2.asm in free low
+// memory (0x500-0xFFF); keep in sync with the BOOT_INFO_* offsets there
+#define BOOT_INFO_ADDR  0x500
+#define BOOT_INFO_MAGIC 0x544F4F42   // "BOOT"
+#define BOOT_MMAP_MAX   64
+
+// TSC stamps the loaders take, in order: boot sector entry, stage 2
+// entry, kernel file read, kernel unpacked and placed (just before the
+// jump to kernel_main)
+#define BOOT_LOADER_STAMPS 4
+
+// E820 range types
+#define E820_USABLE   1
+#define E820_RESERVED 2
+#define E820_ACPI     3
+#define E820_NVS      4
+#define E820_BAD      5
+
+// One BIOS memory map entry (INT 15h, AX=E820h)
+typedef struct {
+    unsigned long long base;
+    unsigned long long length;
+    unsigned int type;
+    unsigned int attributes;
+} __attribute__((packed)) e820_entry_t;
+
+typedef struct {
+    unsigned int magic;
+    unsigned int framebuffer;          // LFB physical address
+    unsigned short pitch;              // Bytes per scanline
+    unsigned short width;
+    unsigned short height;
+    unsigned char bpp;
+    unsigned char boot_drive;
+    unsigned int stack_top;            // Initial kernel stack
+    unsigned int mmap_count;
+    unsigned int kernel_start;         // Physical range the ELF loader
+    unsigned int kernel_end;           // filled, .bss included
+    e820_entry_t mmap[BOOT_MMAP_MAX];
+    unsigned long long loader_tsc[BOOT_LOADER_STAMPS];
+} __attribute__((packed)) boot_info_t;
+
+// Boot info (0 if the bootloader did not provide one)
+static inline const boot_info_t* boot_info() {
+    const boot_info_t* info = (const boot_info_t*)BOOT_INFO_ADDR;
+    return info->magic == BOOT_INFO_MAGIC ? info : 0;
+}
+
+#endif
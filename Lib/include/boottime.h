@@ -0,0 +1,23 @@
+#ifndef BOOTTIME_H
+#define BOOTTIME_H
+
+#include "boot.h"
+
+// Boot phase markers. Each mark is the TSC value at which the named
+// phase ended; a phase started at the previous mark (the first one at
+// TSC 0, i.e. reset). The loaders' stamps come first, from the boot
+// info block, then one mark per kernel init step and a final "prompt"
+// when the shell is on screen.
+#define BOOTTIME_MAX_MARKS 32
+
+typedef struct {
+    const char* name;
+    unsigned long long tsc;
+} boottime_mark_t;
+
+// Function prototypes
+void boottime_init(const boot_info_t* info);
+void boottime_mark(const char* name);
+int boottime_marks(boottime_mark_t* out, int max);
+
+#endif
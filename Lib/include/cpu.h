@@ -0,0 +1,87 @@
+#ifndef CPU_H
+#define CPU_H
+
+// CPUID leaf 1 feature bits (EDX)
+#define CPU_FEATURE_FPU  (1 << 0)
+#define CPU_FEATURE_PSE  (1 << 3)
+#define CPU_FEATURE_TSC  (1 << 4)
+#define CPU_FEATURE_MSR  (1 << 5)
+#define CPU_FEATURE_APIC (1 << 9)
+#define CPU_FEATURE_MTRR (1 << 12)
+#define CPU_FEATURE_PGE  (1 << 13)
+#define CPU_FEATURE_PAT  (1 << 16)
+#define CPU_FEATURE_FXSR (1 << 24)
+#define CPU_FEATURE_SSE  (1 << 25)
+#define CPU_FEATURE_SSE2 (1 << 26)
+
+// Execute CPUID
+static inline void cpuid(unsigned int leaf, unsigned int* eax, unsigned int* ebx,
+                         unsigned int* ecx, unsigned int* edx) {
+    __asm__ __volatile__("cpuid"
+                         : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                         : "a"(leaf), "c"(0));
+}
+
+// Read a model-specific register
+static inline unsigned long long rdmsr(unsigned int msr) {
+    unsigned int low, high;
+    __asm__ __volatile__("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return ((unsigned long long)high << 32) | low;
+}
+
+// Write a model-specific register
+static inline void wrmsr(unsigned int msr, unsigned long long value) {
+    __asm__ __volatile__("wrmsr" : : "c"(msr), "a"((unsigned int)value),
+                         "d"((unsigned int)(value >> 32)));
+}
+
+// Read the time-stamp counter
+static inline unsigned long long rdtsc() {
+    unsigned int low, high;
+    __asm__ __volatile__("rdtsc" : "=a"(low), "=d"(high));
+    return ((unsigned long long)high << 32) | low;
+}
+
+// 64 / 32 bit division without libgcc
+static inline unsigned long long div64_32(unsigned long long n, unsigned int d) {
+    unsigned int high = n >> 32;
+    unsigned int low = n;
+    unsigned int q_high = high / d;
+    unsigned int q_low, r = high % d;
+    __asm__("divl %4" : "=a"(q_low), "=d"(r) : "a"(low), "d"(r), "rm"(d));
+    return ((unsigned long long)q_high << 32) | q_low;
+}
+
+// Keep the compiler from moving memory accesses across this point.
+// x86 does not reorder stores with stores or loads with loads, so this
+// is all a single-producer/single-consumer queue needs.
+static inline void barrier() {
+    __asm__ __volatile__("" : : : "memory");
+}
+
+// Spin-wait hint
+static inline void cpu_pause() {
+    __asm__ __volatile__("pause" : : : "memory");
+}
+
+// Disable interrupts, returning the previous EFLAGS for irq_restore()
+static inline unsigned int irq_save() {
+    unsigned int flags;
+    __asm__ __volatile__("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+// Re-enable interrupts if they were enabled before irq_save()
+static inline void irq_restore(unsigned int flags) {
+    if (flags & (1 << 9)) {
+        __asm__ __volatile__("sti" : : : "memory");
+    }
+}
+
+// Function prototypes
+unsigned int cpu_features();
+int cpu_has(unsigned int feature);
+int cpu_enable_sse();
+void cpu_init_ap();
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef DISPI_H
+#define DISPI_H
+
+// Bochs/QEMU std-vga display interface (index/data port pair)
+#define DISPI_INDEX_PORT 0x1CE
+#define DISPI_DATA_PORT  0x1CF
+
+// Registers
+#define DISPI_INDEX_ID          0x0
+#define DISPI_INDEX_XRES        0x1
+#define DISPI_INDEX_YRES        0x2
+#define DISPI_INDEX_BPP         0x3
+#define DISPI_INDEX_ENABLE      0x4
+#define DISPI_INDEX_BANK        0x5
+#define DISPI_INDEX_VIRT_WIDTH  0x6
+#define DISPI_INDEX_VIRT_HEIGHT 0x7
+#define DISPI_INDEX_X_OFFSET    0x8
+#define DISPI_INDEX_Y_OFFSET    0x9
+#define DISPI_INDEX_VIDEO_MEMORY_64K 0xA
+
+// Interface versions (ID register): B0C2 added virtual screens and
+// display offsets, B0C4 the video memory size register
+#define DISPI_ID0 0xB0C0
+#define DISPI_ID2 0xB0C2
+#define DISPI_ID4 0xB0C4
+#define DISPI_ID5 0xB0C5
+
+// Function prototypes
+unsigned short dispi_read(unsigned short index);
+void dispi_write(unsigned short index, unsigned short value);
+int dispi_detect();
+int dispi_setup_pages(int width, int height, int bpp, int pages);
+void dispi_set_y_offset(int y);
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef GRAPHICS_H
+#define GRAPHICS_H
+
+// VESA mode 0x118 (set by boot_vesa.asm)
+#define SCREEN_WIDTH 1024
+#define SCREEN_HEIGHT 768
+#define SCREEN_BPP 32
+
+// Color in framebuffer byte order (BGRA)
+typedef struct {
+    unsigned char b;
+    unsigned char g;
+    unsigned char r;
+    unsigned char a;
+} color_t;
+
+// Rectangle in screen coordinates
+typedef struct {
+    int x;
+    int y;
+    int width;
+    int height;
+} rect_t;
+
+// Point in screen coordinates
+typedef struct {
+    int x;
+    int y;
+} point_t;
+
+// Predefined colors
+#define COLOR_BLACK   ((color_t){0, 0, 0, 255})
+#define COLOR_WHITE   ((color_t){255, 255, 255, 255})
+#define COLOR_RED     ((color_t){0, 0, 255, 255})
+#define COLOR_GREEN   ((color_t){0, 255, 0, 255})
+#define COLOR_BLUE    ((color_t){255, 0, 0, 255})
+#define COLOR_YELLOW  ((color_t){0, 255, 255, 255})
+#define COLOR_CYAN    ((color_t){255, 255, 0, 255})
+#define COLOR_MAGENTA ((color_t){255, 0, 255, 255})
+#define COLOR_GRAY    ((color_t){128, 128, 128, 255})
+
+// Function prototypes
+void graphics_init();
+unsigned int* graphics_get_framebuffer();
+unsigned int* graphics_get_backbuffer();
+void graphics_clear(color_t color);
+void graphics_putpixel(int x, int y, color_t color);
+color_t graphics_getpixel(int x, int y);
+void graphics_fill_rect(int x, int y, int width, int height, color_t color);
+void graphics_draw_rect(int x, int y, int width, int height, color_t color);
+void graphics_hline(int x, int y, int width, color_t color);
+void graphics_vline(int x, int y, int height, color_t color);
+void graphics_draw_line(int x1, int y1, int x2, int y2, color_t color);
+void graphics_draw_polyline(const point_t* points, int count, color_t color);
+void graphics_set_clip(int x, int y, int width, int height);
+void graphics_reset_clip();
+color_t graphics_blend(color_t fg, color_t bg);
+void graphics_draw_char(int x, int y, char c, color_t fg, color_t bg);
+void graphics_draw_string(int x, int y, const char* str, color_t fg, color_t bg);
+void graphics_draw_text(int x, int y, const char* str, int len, color_t fg, color_t bg);
+void graphics_load_wallpaper();
+void graphics_generate_wallpaper();
+void graphics_restore_background(int x, int y, int width, int height);
+void graphics_restore_tinted(int x, int y, int width, int height, color_t color);
+void graphics_scroll_rect(int x, int y, int width, int height, int dy);
+
+// Damage tracking: all drawing goes to a back buffer in system RAM and
+// only the dirty regions are copied to the framebuffer by graphics_present()
+void graphics_mark_dirty(int x, int y, int width, int height);
+void graphics_present();
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+// Small objects come from slab caches with power-of-two size classes
+// (16 bytes to 1 KB); anything larger is rounded up to whole frames and
+// taken straight from the frame allocator
+#define HEAP_MIN_SHIFT    4
+#define HEAP_CACHE_COUNT  7
+#define HEAP_MAX_SMALL    (1 << (HEAP_MIN_SHIFT + HEAP_CACHE_COUNT - 1))
+
+// Per-cache statistics
+typedef struct {
+    unsigned int object_size;
+    unsigned int slabs;            // Frames held by the cache
+    unsigned int live;             // Objects allocated now
+    unsigned int capacity;         // Object slots in all slabs
+    unsigned int allocs;
+    unsigned int frees;
+} heap_cache_stats_t;
+
+// Statistics for frame-sized allocations
+typedef struct {
+    unsigned int live;
+    unsigned int frames;
+    unsigned int allocs;
+    unsigned int frees;
+} heap_large_stats_t;
+
+// Bump allocator for short-lived scratch memory: allocation is a
+// pointer bump and everything is freed at once by arena_release()
+typedef struct arena_chunk arena_chunk_t;
+typedef struct {
+    arena_chunk_t* chunks;
+    char* cursor;
+    char* limit;
+    unsigned int used;             // Bytes handed out since the release
+} arena_t;
+
+// Function prototypes
+void heap_init();
+void* kmalloc(unsigned int size);
+void* kzalloc(unsigned int size);
+void kfree(void* ptr);
+void heap_get_cache_stats(int index, heap_cache_stats_t* stats);
+void heap_get_large_stats(heap_large_stats_t* stats);
+
+void arena_init(arena_t* arena);
+void* arena_alloc(arena_t* arena, unsigned int size);
+void arena_release(arena_t* arena);
+
+#endif
@@ -18,7 +18,16 @@ struct idt_ptr {
 
 // Function prototypes
 void idt_init();
+void idt_load_cpu();
 void idt_set_gate(unsigned char num, unsigned int base, unsigned short selector, unsigned char flags);
+void pic_unmask(int irq);
+void pic_mask(int irq);
+unsigned short pic_get_mask();
+void pic_set_mask(unsigned short mask);
+void irq_unmask(int irq);
+void irq_mask(int irq);
+void irq_eoi(int irq);
+int pic_spurious(int irq);
 
 // External assembly functions
 extern void idt_load(unsigned int);
@@ -74,5 +83,9 @@ extern void irq_12();
 extern void irq_13();
 extern void irq_14();
 extern void irq_15();
+extern void irq_yield();
+extern void irq_lapic_timer();
+extern void irq_spurious();
+extern void irq_smp_work();
 
 #endif
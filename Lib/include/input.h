@@ -0,0 +1,40 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+// Modifier bits in input_event_t.modifiers
+#define INPUT_MOD_SHIFT 0x01
+#define INPUT_MOD_CTRL  0x02
+#define INPUT_MOD_ALT   0x04
+#define INPUT_MOD_CAPS  0x08
+
+// One key transition
+typedef struct {
+    unsigned long long tsc;        // Time-stamp counter when the IRQ arrived
+    unsigned char scancode;        // Set 1 scancode without the release bit
+    unsigned char keycode;         // ASCII or KEY_* (0: modifier or unmapped)
+    unsigned char modifiers;       // INPUT_MOD_* after this event
+    unsigned char pressed;         // 1 press, 0 release
+} input_event_t;
+
+// Queue capacity (power of two)
+#define INPUT_QUEUE_SIZE 256
+
+// Lock-free single-producer/single-consumer ring. head and tail run
+// freely and are masked on use; only the producer writes head and only
+// the consumer writes tail, so neither side needs to disable
+// interrupts. A full queue drops the new event and counts it.
+typedef struct {
+    input_event_t events[INPUT_QUEUE_SIZE];
+    volatile unsigned int head;    // Next slot to write (producer)
+    volatile unsigned int tail;    // Next slot to read (consumer)
+    volatile unsigned int pushed;  // Events accepted
+    volatile unsigned int dropped; // Events lost to a full queue
+} input_queue_t;
+
+// Function prototypes
+void input_queue_init(input_queue_t* queue);
+int input_queue_push(input_queue_t* queue, const input_event_t* event);
+int input_queue_pop(input_queue_t* queue, input_event_t* out, int max);
+unsigned int input_queue_count(const input_queue_t* queue);
+
+#endif
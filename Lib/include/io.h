@@ -0,0 +1,25 @@
+#ifndef IO_H
+#define IO_H
+
+// Port I/O
+static inline void outb(unsigned short port, unsigned char value) {
+    __asm__ __volatile__("outb %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline unsigned char inb(unsigned short port) {
+    unsigned char value;
+    __asm__ __volatile__("inb %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+static inline void outw(unsigned short port, unsigned short value) {
+    __asm__ __volatile__("outw %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline unsigned short inw(unsigned short port) {
+    unsigned short value;
+    __asm__ __volatile__("inw %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+#endif
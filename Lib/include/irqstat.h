@@ -0,0 +1,48 @@
+#ifndef IRQSTAT_H
+#define IRQSTAT_H
+
+struct registers;
+
+// Interrupt path instrumentation. isr_common_stub and irq_common_stub
+// read the TSC on entry and again after the C handler returns, and
+// hand both to irqstat_record(), so a vector's cost covers everything
+// between the stub's register save and restore. On a CPU without a TSC
+// the stubs pass zeros and only the counts are kept.
+
+// Vectors tracked (everything the IDT installs is below this)
+#define IRQSTAT_VECTORS 128
+
+// Cost histogram: bucket n counts entries of 2^n to 2^(n+1)-1 cycles,
+// the last bucket everything longer
+#define IRQSTAT_BUCKETS 24
+
+typedef struct {
+    unsigned int count;
+    unsigned int min_cycles;
+    unsigned int max_cycles;
+    unsigned int avg_cycles;
+    unsigned long long total_cycles;
+    unsigned int histogram[IRQSTAT_BUCKETS];
+} irqstat_t;
+
+// Events that are not a single vector's cost
+typedef struct {
+    unsigned int nested;           // Entries while already in an interrupt
+    unsigned int spurious_pic7;    // Master PIC spurious IRQ 7
+    unsigned int spurious_pic15;   // Slave PIC spurious IRQ 15
+    unsigned int spurious_lapic;   // Local APIC spurious vector
+} irqstat_totals_t;
+
+// Nonzero when the stubs may read the TSC (set by irqstat_init)
+extern int irqstat_tsc;
+
+// Function prototypes
+void irqstat_init();
+void irqstat_enter();
+void irqstat_record(struct registers* regs, unsigned long long entry, unsigned long long exit);
+void irqstat_spurious(int irq);
+void irqstat_get(int vector, irqstat_t* stats);
+void irqstat_get_totals(irqstat_totals_t* totals);
+void irqstat_reset();
+
+#endif
@@ -11,7 +11,7 @@ struct registers {
 
 // Function prototypes
 void isr_handler(struct registers* regs);
-void irq_handler(struct registers* regs);
+struct registers* irq_handler(struct registers* regs);
 void irq_install_handler(int irq, void (*handler)(struct registers*));
 void irq_uninstall_handler(int irq);
 
@@ -1,6 +1,8 @@
 #ifndef KEYBOARD_H
 #define KEYBOARD_H
 
+#include "input.h"
+
 // Special keys
 #define KEY_BACKSPACE 0x08
 #define KEY_TAB 0x09
@@ -10,11 +12,24 @@
 #define KEY_DOWN 0x81
 #define KEY_LEFT 0x82
 #define KEY_RIGHT 0x83
+#define KEY_PGUP 0x84
+#define KEY_PGDN 0x85
+
+// Event queue counters
+typedef struct {
+    unsigned int events;           // Events queued for readers
+    unsigned int dropped;          // Lost because readers fell behind
+    unsigned int raw_dropped;      // Lost before translation
+} keyboard_stats_t;
 
 // Function prototypes
 void keyboard_init();
 char keyboard_getchar();
 int keyboard_available();
+void keyboard_wait_event();
+int keyboard_read_events(input_event_t* out, int max);
+void keyboard_push_event(const input_event_t* event);
+void keyboard_get_stats(keyboard_stats_t* stats);
 
 // Callback for key press (optional)
 typedef void (*key_handler_t)(char);
@@ -0,0 +1,35 @@
+#ifndef PAGING_H
+#define PAGING_H
+
+// Page sizes
+#define PAGE_SIZE       0x1000
+#define LARGE_PAGE_SIZE 0x400000
+
+// Page directory / table entry bits
+#define PAGE_PRESENT  (1 << 0)
+#define PAGE_WRITE    (1 << 1)
+#define PAGE_PWT      (1 << 3)
+#define PAGE_PCD      (1 << 4)
+#define PAGE_LARGE    (1 << 7)     // PDE: 4 MB page (PSE)
+
+// Memory types (PAT entries and MTRR types)
+#define MEMTYPE_UC  0x00
+#define MEMTYPE_WC  0x01
+#define MEMTYPE_WT  0x04
+#define MEMTYPE_WP  0x05
+#define MEMTYPE_WB  0x06
+#define MEMTYPE_UCM 0x07           // UC-: UC unless an MTRR says WC
+
+// How write-combining was set up for a range
+#define WC_NONE 0
+#define WC_PAT  1
+#define WC_MTRR 2
+
+// Function prototypes
+int paging_init();
+void paging_init_ap();
+int paging_enabled();
+int paging_map_wc(unsigned int base, unsigned int size);
+int paging_map_uc(unsigned int base, unsigned int size);
+
+#endif
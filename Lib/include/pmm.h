@@ -0,0 +1,28 @@
+#ifndef PMM_H
+#define PMM_H
+
+#include "boot.h"
+
+// Physical frames are 4 KB; blocks are 2^order contiguous frames aligned
+// to their size, up to 4 MB (one large page)
+#define FRAME_SIZE     0x1000
+#define PMM_MAX_ORDER  10
+
+// Physical memory statistics (in frames)
+typedef struct {
+    unsigned int total;
+    unsigned int free;
+    unsigned int reserved;
+    unsigned int free_blocks[PMM_MAX_ORDER + 1];
+} pmm_stats_t;
+
+// Function prototypes
+int pmm_init(const boot_info_t* info);
+unsigned int pmm_alloc(int order);
+void pmm_free(unsigned int addr, int order);
+unsigned int pmm_alloc_pages(unsigned int count);
+void pmm_free_pages(unsigned int addr, unsigned int count);
+int pmm_order_for(unsigned int bytes);
+void pmm_get_stats(pmm_stats_t* stats);
+
+#endif
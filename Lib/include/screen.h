@@ -6,6 +6,10 @@
 #define VGA_HEIGHT 25
 #define VGA_MEMORY 0xB8000
 
+// The 32 KB text window at VGA_MEMORY holds this many full rows; the
+// CRTC start address selects which of them are on screen
+#define VGA_WINDOW_ROWS (0x8000 / (VGA_WIDTH * 2))
+
 // Color codes
 #define COLOR_BLACK 0
 #define COLOR_BLUE 1
@@ -24,6 +28,9 @@
 #define COLOR_YELLOW 14
 #define COLOR_WHITE 15
 
+// Receives a copy of everything printed (e.g. serial_write)
+typedef void (*screen_mirror_t)(const char* data, int length);
+
 // Function prototypes
 void screen_init();
 void screen_clear();
@@ -32,5 +39,8 @@ void screen_print(const char* str);
 void screen_println(const char* str);
 void screen_set_color(unsigned char fg, unsigned char bg);
 void screen_scroll();
+void screen_set_hardware_scroll(int enabled);
+void screen_set_mirror(screen_mirror_t mirror);
+void screen_set_display(int enabled);
 
 #endif
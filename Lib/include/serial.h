@@ -0,0 +1,30 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+// COM1 16550 console. Output is queued in a ring and moved to the UART
+// 16 bytes at a time by the transmit interrupt, so writers never poll
+// the line status per byte. Received bytes become input events in the
+// keyboard's queue, so the shell reads both sources the same way.
+#define SERIAL_COM1      0x3F8
+#define SERIAL_IRQ       4
+#define SERIAL_BAUD      115200
+
+// Transmit ring size (power of two)
+#define SERIAL_TX_SIZE   4096
+
+typedef struct {
+    unsigned int tx_bytes;         // Bytes handed to the UART
+    unsigned int tx_dropped;       // Lost to a full ring with no way to wait
+    unsigned int rx_bytes;         // Bytes received
+    unsigned int rx_dropped;       // Lost before translation
+} serial_stats_t;
+
+// Function prototypes
+int serial_init();
+int serial_present();
+void serial_write(const char* data, int length);
+void serial_print(const char* str);
+void serial_flush();
+void serial_get_stats(serial_stats_t* stats);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef SMP_H
+#define SMP_H
+
+#define SMP_MAX_CPUS 16
+
+// Real-mode startup code for application processors is copied here
+// (page aligned, below 1 MB, above the boot stack); keep in sync with
+// smp_trampoline.asm
+#define SMP_TRAMPOLINE_ADDR 0x91000
+
+// IPI that tells application processors new work is posted
+#define SMP_WORK_VECTOR 65
+
+// Application processor stack size in frames (16 KB)
+#define SMP_STACK_FRAMES 4
+
+// Part index of count of a job posted with smp_run()
+typedef void (*smp_work_fn)(void* arg, int index, int count);
+
+// Per-CPU data
+typedef struct {
+    unsigned long long gdt[3];     // Null, flat code 0x08, flat data 0x10
+    int index;                     // 0 is the boot CPU
+    unsigned int apic_id;
+    volatile int online;
+    unsigned int stack;            // Stack frames (0 for the boot CPU)
+    unsigned int work_runs;        // smp_run() parts executed
+    int irq_depth;                 // Interrupts being handled
+} cpu_t;
+
+// Function prototypes
+int smp_init();
+int smp_cpu_count();
+cpu_t* smp_cpu(int index);
+cpu_t* cpu_current();
+void smp_run(smp_work_fn fn, void* arg);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+// Deferred interrupt work. A top half (the IRQ handler) captures what
+// the hardware hands it and raises its softirq; the handler registered
+// for that softirq runs later in the softirqd thread with interrupts
+// enabled. One softirq per IRQ line, lower numbers run first.
+#define SOFTIRQ_COUNT 16
+
+#define SOFTIRQ_KEYBOARD 1
+#define SOFTIRQ_SERIAL   4
+
+typedef void (*softirq_fn)(void* data);
+
+typedef struct {
+    unsigned int raised;           // softirq_raise() calls
+    unsigned int runs;             // Handler invocations
+    unsigned long long max_delay_ns;  // Longest raise-to-run delay
+} softirq_stats_t;
+
+// Function prototypes
+void softirq_init();
+void softirq_register(int nr, softirq_fn fn, void* data);
+void softirq_raise(int nr);
+void softirq_run();
+void softirq_get_stats(int nr, softirq_stats_t* stats);
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef TERMINAL_H
+#define TERMINAL_H
+
+#include "graphics.h"
+
+// Character cell size in pixels (8x8 font)
+#define TERMINAL_CELL_WIDTH 8
+#define TERMINAL_CELL_HEIGHT 8
+
+// Largest grid (a full 1024x768 screen)
+#define TERMINAL_MAX_COLS (SCREEN_WIDTH / TERMINAL_CELL_WIDTH)
+#define TERMINAL_MAX_ROWS (SCREEN_HEIGHT / TERMINAL_CELL_HEIGHT)
+
+// Colors used by cells (cells store palette indices)
+#define TERMINAL_PALETTE_SIZE 64
+
+// Scrollback history
+#define TERMINAL_SCROLLBACK_LINES 2000
+#define TERMINAL_SCROLLBACK_BYTES (96 * 1024)
+
+// One character cell
+typedef struct {
+    unsigned char ch;
+    unsigned char fg;   // Palette index
+    unsigned char bg;   // Palette index
+    unsigned char flags;
+} terminal_cell_t;
+
+// Lines that scrolled off the top, stored compactly in a byte ring.
+// Each line is [text length][run count][text][(fg, bg, length) runs]:
+// trailing blanks are dropped from the text and attributes are
+// run-length encoded, so a typical line costs a few dozen bytes.
+typedef struct {
+    unsigned char data[TERMINAL_SCROLLBACK_BYTES];
+    unsigned int offsets[TERMINAL_SCROLLBACK_LINES];   // Line start (ring)
+    int first;                                          // Oldest line slot
+    int count;                                          // Lines stored
+    unsigned int head;                                  // Next free byte
+    unsigned int used;                                  // Bytes in use
+} terminal_scrollback_t;
+
+// Graphical terminal: a character grid with per-cell dirty bits.
+// Printing only updates cells; terminal_render() repaints what changed.
+// Receives a copy of everything printed (e.g. serial_write)
+typedef void (*terminal_mirror_t)(const char* data, int length);
+
+// Rows form a ring (screen row r is cells[(top + r) % rows]), so a
+// scroll is an index bump; dirty bits belong to the stored row and so
+// move with it.
+typedef struct terminal {
+    int x, y;                       // Pixel origin
+    int cols, rows;
+    int top;                        // Ring index of screen row 0
+    int cursor_x, cursor_y;
+    int cursor_visible;
+    int drawn_cursor_x, drawn_cursor_y;
+    unsigned char fg, bg;           // Current palette indices
+    int bg_translucent;             // A translucent background is in use
+    int pending_scroll;             // Rows scrolled since the last render
+    int view_offset;                // Lines scrolled back into history
+    terminal_mirror_t mirror;       // Output copy, 0 for none
+    
+    color_t palette[TERMINAL_PALETTE_SIZE];
+    int palette_count;
+    
+    terminal_cell_t cells[TERMINAL_MAX_ROWS][TERMINAL_MAX_COLS];
+    unsigned int cell_dirty[TERMINAL_MAX_ROWS][TERMINAL_MAX_COLS / 32];
+    unsigned char row_dirty[TERMINAL_MAX_ROWS];
+    int any_dirty;
+    
+    terminal_cell_t history_row[TERMINAL_MAX_COLS];    // Decode buffer
+    terminal_scrollback_t scrollback;
+} terminal_t;
+
+// Function prototypes
+void terminal_init(terminal_t* term, int x, int y, int cols, int rows);
+void terminal_clear(terminal_t* term);
+void terminal_set_color(terminal_t* term, color_t fg, color_t bg);
+void terminal_set_mirror(terminal_t* term, terminal_mirror_t mirror);
+void terminal_putchar(terminal_t* term, char c);
+void terminal_print(terminal_t* term, const char* str);
+void terminal_println(terminal_t* term, const char* str);
+void terminal_set_cursor_visible(terminal_t* term, int visible);
+void terminal_invalidate(terminal_t* term, int x, int y, int width, int height);
+void terminal_scroll_view(terminal_t* term, int lines);
+void terminal_render(terminal_t* term);
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+struct registers;
+
+// Priority levels, highest first. The scheduler always runs the first
+// non-empty level and round-robins within it.
+#define THREAD_PRIORITY_HIGH    0
+#define THREAD_PRIORITY_NORMAL  1
+#define THREAD_PRIORITY_LOW     2
+#define THREAD_PRIORITY_IDLE    3
+#define THREAD_PRIORITIES       4
+
+// Thread states
+#define THREAD_READY    0
+#define THREAD_RUNNING  1
+#define THREAD_BLOCKED  2
+#define THREAD_DEAD     3
+
+// Kernel stack size in frames (16 KB)
+#define THREAD_STACK_FRAMES 4
+
+// Ticks a thread runs before others at its level get the CPU
+#define THREAD_TIME_SLICE 10
+
+// Software interrupt a thread raises to give up the CPU. It goes
+// through irq_common_stub like a hardware IRQ, so voluntary and
+// preemptive switches share one path.
+#define THREAD_YIELD_VECTOR 48
+
+#define THREAD_NAME_LENGTH 16
+
+typedef void (*thread_fn)(void* arg);
+
+typedef struct thread {
+    unsigned char fx_state[512] __attribute__((aligned(16)));  // FXSAVE area
+    struct registers* context;     // Saved frame while not running
+    struct thread* next;           // Run queue or wait queue link
+    struct thread* all_next;       // Every thread, for listing
+    unsigned int stack;            // Stack frames (0 for the boot thread)
+    thread_fn fn;
+    void* arg;
+    int id;
+    int priority;
+    int state;
+    int slice;                     // Ticks left in the current slice
+    unsigned int run_ticks;        // Ticks spent running
+    char name[THREAD_NAME_LENGTH];
+} thread_t;
+
+// Threads blocked until an event
+typedef struct {
+    thread_t* head;
+    thread_t* tail;
+} wait_queue_t;
+
+// Snapshot of one thread for listings
+typedef struct {
+    int id;
+    int priority;
+    int state;
+    unsigned int run_ticks;
+    char name[THREAD_NAME_LENGTH];
+} thread_info_t;
+
+// Function prototypes
+void sched_init();
+int sched_running();
+void sched_tick();
+struct registers* sched_switch(struct registers* regs);
+thread_t* thread_create(const char* name, thread_fn fn, void* arg, int priority);
+thread_t* thread_current();
+void thread_set_priority(thread_t* thread, int priority);
+void thread_yield();
+void thread_exit();
+void thread_block();
+void thread_wake(thread_t* thread);
+void thread_sleep_ms(unsigned int ms);
+void thread_idle();
+int thread_list(thread_info_t* out, int max);
+void wait_queue_init(wait_queue_t* queue);
+void thread_wait(wait_queue_t* queue);
+void thread_wake_all(wait_queue_t* queue);
+
+#endif
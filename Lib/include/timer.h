@@ -0,0 +1,36 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+// PIT input clock and default tick rate
+#define PIT_FREQUENCY     1193182
+#define TIMER_DEFAULT_HZ  1000
+
+// Timer wheel: one slot per tick, timers further out than a turn wait
+// in their slot for the right lap
+#define TIMER_WHEEL_SLOTS 256
+
+// Timer callback, run from the timer interrupt with interrupts disabled
+typedef void (*timer_fn)(void* data);
+
+typedef struct timer {
+    struct timer* next;
+    struct timer* prev;
+    unsigned int expires;          // Tick at which to fire
+    timer_fn fn;
+    void* data;
+    int pending;
+} timer_t;
+
+// Function prototypes
+void timer_init(unsigned int hz);
+unsigned int timer_hz();
+unsigned int timer_ticks();
+unsigned long long timer_tsc_hz();
+unsigned long long timer_now_ns();
+unsigned int timer_now_ms();
+unsigned long long timer_cycles_to_ns(unsigned long long cycles);
+void timer_add(timer_t* timer, unsigned int delay_ms, timer_fn fn, void* data);
+int timer_cancel(timer_t* timer);
+void sleep_ms(unsigned int ms);
+
+#endif
@@ -0,0 +1,164 @@
+#!/bin/bash
+
+# Boot build/os.img headless, run the kernel's "bench" command over
+# COM1 and check the results.
+#
+#   ./Scripts/bench.sh            check against the golden hashes and
+#                                 this machine's cycle baseline
+#   ./Scripts/bench.sh --update   store this run as the cycle baseline
+#   ./Scripts/bench.sh --golden   store this run's hashes as golden
+#
+# Region hashes must match Scripts/bench_golden.jsonl exactly (the
+# pixels changed otherwise). They do not depend on the machine: each
+# region is cleared first, the colors are fixed, and the SSE2 and
+# scalar kernels give the same pixels. Only rewrite them with --golden
+# for an intended change to the output.
+#
+# min_cycles may be up to BENCH_TOLERANCE percent (default 25) above
+# Scripts/bench_baseline.jsonl. Cycle counts only compare on the
+# machine that recorded them, so that file is per machine and not
+# checked in; without one only the hashes are checked.
+
+# Go to project root if we're in Scripts folder
+if [ -d "../boot" ]; then
+    cd ..
+fi
+
+GOLDEN=Scripts/bench_golden.jsonl
+BASELINE=Scripts/bench_baseline.jsonl
+RESULTS=build/bench.jsonl
+TOLERANCE=${BENCH_TOLERANCE:-25}
+TIMEOUT=${BENCH_TIMEOUT:-120}
+
+if [ ! -f "build/os.img" ]; then
+    echo "Error: build/os.img not found!"
+    echo "Please run ./Scripts/build_graphical.sh first"
+    exit 1
+fi
+
+# The kernel's serial console is QEMU's stdio; "bench exit" ends the run
+# through isa-debug-exit, which makes QEMU exit with status 1
+coproc QEMU {
+    timeout $TIMEOUT qemu-system-i386 \
+        -drive format=raw,file=build/os.img,index=0,if=ide \
+        -boot c \
+        -m 32M \
+        -smp 4 \
+        -display none \
+        -monitor none \
+        -serial stdio \
+        -device isa-debug-exit,iobase=0xf4,iosize=0x04
+}
+exec 3<&"${QEMU[0]}" 4>&"${QEMU[1]}"
+
+# The prompt ends in "$ " with no newline after it
+echo "Waiting for the shell..."
+prompt=0
+while IFS= read -r -t $TIMEOUT -d '$' chunk <&3; do
+    if [[ "$chunk" == *"root@seppuku:~" ]]; then
+        prompt=1
+        break
+    fi
+done
+if [ $prompt -eq 0 ]; then
+    echo "Error: no shell prompt on the serial console"
+    exit 1
+fi
+
+echo "Running benchmarks..."
+printf 'bench exit\r' >&4
+: > $RESULTS
+while IFS= read -r -t $TIMEOUT line <&3; do
+    line=${line%$'\r'}
+    if [[ "$line" == '{"bench'* ]]; then
+        echo "$line" >> $RESULTS
+    fi
+done
+wait $QEMU_PID
+status=$?
+exec 3<&- 4>&-
+
+if [ $status -ne 1 ] || ! grep -q '"bench_done"' $RESULTS; then
+    echo "Error: benchmark run did not finish (QEMU status $status)"
+    exit 1
+fi
+
+if [ "$1" == "--update" ]; then
+    grep -v '"bench_done"' $RESULTS | sed 's/,"hash":"[^"]*"//' > $BASELINE
+    echo "Cycle baseline written to $BASELINE"
+    exit 0
+fi
+if [ "$1" == "--golden" ]; then
+    grep '"hash"' $RESULTS | sed 's/"iterations".*,\("hash"\)/\1/' > $GOLDEN
+    echo "Golden hashes written to $GOLDEN"
+    exit 0
+fi
+
+if [ ! -f "$GOLDEN" ]; then
+    echo "Error: $GOLDEN not found"
+    exit 1
+fi
+if [ ! -f "$BASELINE" ]; then
+    echo "No cycle baseline yet; run ./Scripts/bench.sh --update to record one"
+fi
+
+# Value of a flat JSON field ("key":123 or "key":"text")
+field() {
+    echo "$1" | sed -n "s/.*\"$2\":\"\{0,1\}\([^\",}]*\).*/\1/p"
+}
+
+# The line for benchmark $2 in file $1, if any
+entry() {
+    [ -f "$1" ] && grep -F "\"bench\":\"$2\"" "$1"
+}
+
+failed=0
+printf "%-16s %12s %12s %8s  %s\n" "benchmark" "baseline" "now" "change" "pixels"
+while IFS= read -r now; do
+    name=$(field "$now" bench)
+    if [ -z "$name" ]; then
+        continue
+    fi
+    now_cycles=$(field "$now" min_cycles)
+
+    verdict="-"
+    golden=$(entry $GOLDEN "$name")
+    if [ -n "$golden" ]; then
+        verdict="same"
+        if [ "$(field "$golden" hash)" != "$(field "$now" hash)" ]; then
+            verdict="DIFFERENT"
+            failed=1
+        fi
+    elif [ -n "$(field "$now" hash)" ]; then
+        verdict="NO GOLDEN"
+        failed=1
+    fi
+
+    base=$(entry $BASELINE "$name")
+    if [ -z "$base" ]; then
+        printf "%-16s %12s %12s %8s  %s\n" "$name" "-" "$now_cycles" "-" "$verdict"
+        continue
+    fi
+    base_cycles=$(field "$base" min_cycles)
+    change=$(( (now_cycles - base_cycles) * 100 / (base_cycles > 0 ? base_cycles : 1) ))
+    if [ $change -gt $TOLERANCE ]; then
+        verdict="$verdict SLOWER"
+        failed=1
+    fi
+    printf "%-16s %12s %12s %7s%%  %s\n" "$name" "$base_cycles" "$now_cycles" "$change" "$verdict"
+done < $RESULTS
+
+# Every golden region must still be drawn
+while IFS= read -r golden; do
+    name=$(field "$golden" bench)
+    if [ -n "$name" ] && [ -z "$(entry $RESULTS "$name")" ]; then
+        printf "%-16s %12s %12s %8s  %s\n" "$name" "-" "-" "-" "MISSING"
+        failed=1
+    fi
+done < $GOLDEN
+
+if [ $failed -ne 0 ]; then
+    echo "FAILED: pixels changed or a benchmark got more than $TOLERANCE% slower"
+    exit 1
+fi
+echo "OK"
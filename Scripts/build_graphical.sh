@@ -8,40 +8,116 @@ fi
 
 mkdir -p build
 
-echo "[1/11] Assembling VESA bootloader..."
+echo "[1/32] Assembling VESA bootloader..."
 nasm -f bin boot/boot_vesa.asm -o build/boot.bin
 
-echo "[2/11] Assembling IDT handlers..."
+echo "[2/32] Assembling kernel loader..."
+nasm -f bin boot/stage2.asm -o build/stage2.bin
+
+echo "[3/32] Assembling IDT handlers..."
 nasm -f elf32 Kernel/idt.asm -o build/idt_asm.o
 
-echo "[3/11] Compiling graphics driver..."
+echo "[4/32] Assembling AP trampoline..."
+nasm -f elf32 Kernel/smp_trampoline.asm -o build/smp_trampoline.o
+
+echo "[5/32] Compiling graphics driver..."
 gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/drivers/graphics.c -o build/graphics.o
 
-echo "[4/11] Compiling terminal emulator..."
+echo "[6/32] Compiling blend kernels..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/drivers/blend.c -o build/blend.o
+
+echo "[7/32] Compiling DISPI support..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/drivers/dispi.c -o build/dispi.o
+
+echo "[8/32] Compiling terminal emulator..."
 gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/drivers/terminal.c -o build/terminal.o
 
-echo "[5/11] Compiling keyboard driver..."
+echo "[9/32] Compiling input queue..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/input.c -o build/input.o
+
+echo "[10/32] Compiling keyboard driver..."
 gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/drivers/keyboard.c -o build/keyboard.o
 
-echo "[6/11] Compiling graphical shell..."
+echo "[11/32] Compiling text screen driver..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/drivers/screen.c -o build/screen.o
+
+echo "[12/32] Compiling serial driver..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/drivers/serial.c -o build/serial.o
+
+
+echo "[13/32] Compiling graphical shell..."
 gcc -m32 -ffreestanding -fno-pie -fno-PIC -c user/shell/shell_graphical.c -o build/shell_graphical.o
 
-echo "[7/11] Compiling ISR handler..."
+echo "[14/32] Compiling ISR handler..."
 gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/isr.c -o build/isr.o
 
-echo "[8/11] Compiling IDT..."
+echo "[15/32] Compiling IDT..."
 gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/idt.c -o build/idt.o
 
-echo "[9/11] Compiling kernel..."
+echo "[16/32] Compiling CPU support..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/cpu.c -o build/cpu.o
+
+echo "[17/32] Compiling paging..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/paging.c -o build/paging.o
+
+echo "[18/32] Compiling frame allocator..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/pmm.c -o build/pmm.o
+
+echo "[19/32] Compiling kernel heap..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/heap.c -o build/heap.o
+
+echo "[20/32] Compiling timer..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/timer.c -o build/timer.o
+
+echo "[21/32] Compiling threads..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/thread.c -o build/thread.o
+
+echo "[22/32] Compiling deferred interrupt work..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/softirq.c -o build/softirq.o
+
+echo "[23/32] Compiling ACPI tables..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/acpi.c -o build/acpi.o
+
+echo "[24/32] Compiling APIC..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/apic.c -o build/apic.o
+
+echo "[25/32] Compiling SMP support..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/smp.c -o build/smp.o
+
+echo "[26/32] Compiling interrupt statistics..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/irqstat.c -o build/irqstat.o
+
+echo "[27/32] Compiling boot timing..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/boottime.c -o build/boottime.o
+
+echo "[28/32] Compiling benchmarks..."
+gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/bench.c -o build/bench.o
+
+echo "[29/32] Compiling kernel..."
 gcc -m32 -ffreestanding -fno-pie -fno-PIC -c Kernel/kernel_graphical.c -o build/kernel.o
 
-echo "[10/11] Linking kernel..."
-ld -m elf_i386 -Ttext 0x1000 --oformat binary \
-   -e kernel_main \
-   build/kernel.o build/graphics.o build/terminal.o build/keyboard.o \
-   build/shell_graphical.o build/idt.o build/isr.o build/idt_asm.o \
-   -o build/kernel.bin
+echo "[30/32] Linking kernel..."
+ld -m elf_i386 -T Kernel/linker.ld -z max-page-size=0x1000 \
+   build/kernel.o build/graphics.o build/blend.o build/dispi.o build/terminal.o build/input.o build/keyboard.o build/screen.o build/serial.o \
+   build/shell_graphical.o build/idt.o build/isr.o build/cpu.o build/paging.o build/pmm.o build/heap.o build/timer.o \
+   build/thread.o build/softirq.o build/acpi.o build/apic.o build/smp.o build/irqstat.o build/boottime.o build/bench.o \
+   build/idt_asm.o build/smp_trampoline.o \
+   -o build/kernel.elf
 
-echo "[11/11] Creating disk image..."
-dd if=/dev/zero of=build/os.img bs=512 count=2880 2>/dev/null
-dd if=build/boot.bin of=build/os.
+echo "[31/32] Packing kernel..."
+gcc -O2 toolchain/lz4pack.c -o build/lz4pack || exit 1
+objcopy --strip-all build/kernel.elf build/kernel_stripped.elf || exit 1
+build/lz4pack build/kernel_stripped.elf build/kernel.lz4 || exit 1
+
+# Layout: boot sector, 16 sectors of stage 2, then the packed kernel.
+# The image is at least a floppy's size and grows with the kernel.
+echo "[32/32] Creating disk image..."
+kernel_sectors=$(( ($(stat -c%s build/kernel.lz4) + 511) / 512 ))
+image_sectors=$(( 17 + kernel_sectors ))
+if [ $image_sectors -lt 2880 ]; then
+    image_sectors=2880
+fi
+dd if=/dev/zero of=build/os.img bs=512 count=$image_sectors 2>/dev/null
+dd if=build/boot.bin of=build/os.img bs=512 count=1 conv=notrunc 2>/dev/null
+dd if=build/stage2.bin of=build/os.img bs=512 seek=1 conv=notrunc 2>/dev/null
+dd if=build/kernel.lz4 of=build/os.img bs=512 seek=17 conv=notrunc 2>/dev/null
@@ -1,4 +1,4 @@
 #!/bin/bash
 echo "Cleaning build directory..."
-rm -f build/*.bin build/*.o
+rm -f build/*.bin build/*.elf build/*.lz4 build/*.o build/lz4pack
 echo "Clean complete!"
@@ -43,21 +43,51 @@ fi
 
 echo ""
 
+# Check stage 2 loader
+if [ -f "build/stage2.bin" ]; then
+    size=$(stat -c%s build/stage2.bin)
+    echo "✅ Stage 2 loader: $size bytes"
+    
+    if [ $size -ne 8192 ]; then
+        echo "   ⚠️  Warning: Should be exactly 8192 bytes (16 sectors)"
+    fi
+else
+    echo "❌ stage2.bin not found!"
+fi
+
+echo ""
+
 # Check kernel
-if [ -f "build/kernel.bin" ]; then
-    size=$(stat -c%s build/kernel.bin)
+if [ -f "build/kernel.elf" ]; then
+    size=$(stat -c%s build/kernel.elf)
     echo "✅ Kernel: $size bytes"
     
     # Calculate sectors needed
     sectors=$((($size + 511) / 512))
-    echo "   📊 Requires $sectors sectors"
+    echo "   📊 $sectors sectors unpacked"
+    
+    magic=$(xxd -l 4 -p build/kernel.elf)
+    if [ "$magic" = "7f454c46" ]; then
+        echo "   ✅ ELF header present"
+    else
+        echo "   ❌ Not an ELF file! Found: 0x$magic"
+    fi
+else
+    echo "❌ kernel.elf not found!"
+fi
+
+# Check packed kernel (what the image actually holds)
+if [ -f "build/kernel.lz4" ]; then
+    size=$(stat -c%s build/kernel.lz4)
+    sectors=$((($size + 511) / 512))
+    echo "✅ Packed kernel: $size bytes, $sectors sectors"
     
-    if [ $sectors -gt 50 ]; then
-        echo "   ⚠️  Warning: Kernel needs more than 50 sectors!"
-        echo "   💡 Update boot.asm to load more sectors (currently: 50)"
+    magic=$(xxd -l 4 -p build/kernel.lz4)
+    if [ "$magic" != "4c5a344b" ]; then
+        echo "   ❌ LZ4K header missing! Found: 0x$magic"
     fi
 else
-    echo "❌ kernel.bin not found!"
+    echo "❌ kernel.lz4 not found!"
 fi
 
 echo ""
@@ -68,10 +98,10 @@ if [ -f "build/os.img" ]; then
     echo "✅ Disk Image: $size bytes"
     
     expected=$((2880 * 512))
-    if [ $size -eq $expected ]; then
-        echo "   ✅ Correct floppy size (1.44MB)"
+    if [ $size -ge $expected ]; then
+        echo "   ✅ At least floppy size (1.44MB)"
     else
-        echo "   ⚠️  Expected $expected bytes"
+        echo "   ⚠️  Expected at least $expected bytes"
     fi
     
     # Check first sector
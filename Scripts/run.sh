@@ -14,12 +14,13 @@ fi
 
 echo "Starting SEPPUKU OS in QEMU..."
 echo "Press Ctrl+Alt+G to release mouse"
-echo "Press Ctrl+C in terminal to quit"
+echo "COM1 is on this terminal; Ctrl+A C switches to the monitor"
 echo ""
 
 # Run QEMU with better options
 qemu-system-i386 \
-    -drive format=raw,file=build/os.img,index=0,if=floppy \
-    -boot a \
+    -drive format=raw,file=build/os.img,index=0,if=ide \
+    -boot c \
     -m 32M \
-    -monitor stdio
+    -smp 4 \
+    -serial mon:stdio
@@ -1,6 +1,29 @@
 BITS 16
 ORG 0x7C00
 
+; Boot info handed to the kernel (see Lib/include/boot.h)
+BOOT_INFO_ADDR       equ 0x500
+BOOT_INFO_FB         equ 4
+BOOT_INFO_PITCH      equ 8
+BOOT_INFO_WIDTH      equ 10
+BOOT_INFO_BPP        equ 14
+BOOT_INFO_DRIVE      equ 15
+BOOT_INFO_MMAP_COUNT equ 20
+BOOT_INFO_MMAP       equ 32
+BOOT_MMAP_MAX        equ 64
+E820_ENTRY_SIZE      equ 24
+BOOT_INFO_TSC        equ 1568           ; Loader stamps, after the map
+BOOT_LOADER_STAMPS   equ 4
+CPUID_TSC            equ 1 << 4
+
+; Stage 2 (boot/stage2.asm) loads the kernel; it follows this sector
+STAGE2_ADDR          equ 0x1000
+STAGE2_SECTORS       equ 16
+
+; VBE scratch blocks, just past the boot sector
+vbe_info_block       equ 0x7E00
+mode_info_block      equ 0x8000
+
 start:
     xor ax, ax
     mov ds, ax
@@ -8,7 +31,24 @@ start:
     mov ss, ax
     mov sp, 0x7C00
     
+    ; First loader stamp: everything before it is firmware. Without a
+    ; TSC (CPUID.1:EDX bit 4) every stamp stays 0 and the kernel skips it.
+    xor ax, ax
+    mov di, BOOT_INFO_ADDR + BOOT_INFO_TSC
+    mov cx, BOOT_LOADER_STAMPS * 4
+    cld
+    rep stosw
+    mov eax, 1
+    cpuid
+    test edx, CPUID_TSC
+    jz .no_tsc
+    rdtsc
+    mov [BOOT_INFO_ADDR + BOOT_INFO_TSC], eax
+    mov [BOOT_INFO_ADDR + BOOT_INFO_TSC + 4], edx
+.no_tsc:
+    
     mov [boot_drive], dl
+    mov [BOOT_INFO_ADDR + BOOT_INFO_DRIVE], dl
 
     mov si, msg_loading
     call print_string
@@ -35,36 +75,56 @@ start:
     mov di, mode_info_block
     int 0x10
     
-    ; Store framebuffer address for kernel
+    ; Store framebuffer address and geometry for kernel
     mov eax, [mode_info_block + 40]  ; Physical base pointer
-    mov [framebuffer_addr], eax
+    mov [BOOT_INFO_ADDR + BOOT_INFO_FB], eax
+    mov ax, [mode_info_block + 16]   ; Bytes per scanline
+    mov [BOOT_INFO_ADDR + BOOT_INFO_PITCH], ax
+    mov eax, [mode_info_block + 18]  ; Width, height
+    mov [BOOT_INFO_ADDR + BOOT_INFO_WIDTH], eax
+    mov al, [mode_info_block + 25]   ; Bits per pixel
+    mov [BOOT_INFO_ADDR + BOOT_INFO_BPP], al
     
     mov si, msg_vesa_ok
     call print_string
 
-    ; Load kernel sectors
+    ; Collect the E820 memory map
+    mov di, BOOT_INFO_ADDR + BOOT_INFO_MMAP
+    xor ebx, ebx
+    xor bp, bp
+.e820_next:
+    mov eax, 0xE820
+    mov edx, 0x534D4150             ; 'SMAP'
+    mov ecx, E820_ENTRY_SIZE
+    mov dword [di + 20], 1          ; Valid, for BIOSes returning 20 bytes
+    int 0x15
+    jc .e820_done
+    cmp eax, 0x534D4150
+    jne .e820_done
+    inc bp
+    add di, E820_ENTRY_SIZE
+    cmp bp, BOOT_MMAP_MAX
+    jae .e820_done
+    test ebx, ebx
+    jnz .e820_next
+.e820_done:
+    movzx ebp, bp                   ; mmap_count is a dword
+    mov [BOOT_INFO_ADDR + BOOT_INFO_MMAP_COUNT], ebp
+    ; Load stage 2 from the sectors after this one. It sits on the first
+    ; track, so one CHS read works on floppies and hard disks alike.
     mov ah, 0x02
-    mov al, 50
+    mov al, STAGE2_SECTORS
     mov ch, 0
     mov cl, 2
     mov dh, 0
     mov dl, [boot_drive]
-    mov bx, 0x1000
+    mov bx, STAGE2_ADDR
     int 0x13
     
     jc disk_error
 
-    mov si, msg_success
-    call print_string
-
-    cli
-    lgdt [gdt_descriptor]
-    
-    mov eax, cr0
-    or eax, 1
-    mov cr0, eax
-    
-    jmp 0x08:protected_mode
+    mov dl, [boot_drive]
+    jmp 0x0000:STAGE2_ADDR
 
 vesa_error:
     mov si, msg_vesa_error
@@ -90,51 +150,11 @@ print_string:
     ret
 
 boot_drive db 0
-framebuffer_addr dd 0
 
 msg_loading db 'SEPPUKU OS - Initializing VESA...', 13, 10, 0
 msg_vesa_ok db 'VESA mode set: 1024x768x32', 13, 10, 0
-msg_success db 'Kernel loaded! Starting...', 13, 10, 0
 msg_error db 'DISK ERROR!', 13, 10, 0
 msg_vesa_error db 'VESA ERROR! Graphics mode not supported', 13, 10, 0
 
-gdt_start:
-    dd 0x0, 0x0
-    dw 0xFFFF, 0x0
-    db 0x0, 10011010b, 11001111b, 0x0
-    dw 0xFFFF, 0x0
-    db 0x0, 10010010b, 11001111b, 0x0
-gdt_end:
-
-gdt_descriptor:
-    dw gdt_end - gdt_start - 1
-    dd gdt_start
-
-BITS 32
-protected_mode:
-    mov ax, 0x10
-    mov ds, ax
-    mov es, ax
-    mov fs, ax
-    mov gs, ax
-    mov ss, ax
-    mov esp, 0x90000
-    
-    ; Pass framebuffer address to kernel (in a known location)
-    mov eax, [framebuffer_addr]
-    mov [0x5000], eax       ; Store at 0x5000 for kernel to read
-    
-    call 0x1000
-    
-    jmp $
-
-; VBE Info Block
-vbe_info_block:
-    times 512 db 0
-
-; Mode Info Block  
-mode_info_block:
-    times 256 db 0
-
 times 510-($-$$) db 0
 dw 0xAA55
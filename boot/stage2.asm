@@ -0,0 +1,544 @@
+BITS 16
+ORG 0x1000
+
+; Stage 2: loads the ELF kernel and enters it in protected mode. The
+; boot sector has already set the video mode and collected the memory
+; map, and jumps here with the boot drive in DL.
+;
+; The kernel file is read in chunks of up to BOUNCE_SECTORS through a
+; buffer below 1 MB (the only memory the BIOS can write), using INT 13h
+; extensions when the drive has them and CHS reads of up to a whole
+; track otherwise. Each chunk is copied to KERNEL_STAGING in unreal
+; mode; the PT_LOAD segments are then copied from there to their
+; physical addresses in protected mode.
+;
+; The file may instead be an LZ4 block packed by toolchain/lz4pack.c
+; behind a PACK_HEADER_SIZE header. That is staged at KERNEL_PACKED and
+; decompressed to KERNEL_STAGING first, so fewer sectors are read.
+
+; Boot info handed to the kernel (see Lib/include/boot.h)
+BOOT_INFO_ADDR         equ 0x500
+BOOT_INFO_MAGIC        equ 0x544F4F42
+BOOT_INFO_STACK        equ 16
+BOOT_INFO_KERNEL_START equ 24
+BOOT_INFO_KERNEL_END   equ 28
+BOOT_INFO_TSC          equ 1568          ; 4 stamps, the first from stage 1
+
+CPUID_TSC              equ 1 << 4
+
+STAGE2_SECTORS         equ 16            ; As loaded by boot_vesa.asm
+
+KERNEL_STACK           equ 0x90000
+KERNEL_LBA             equ 1 + STAGE2_SECTORS
+KERNEL_LOWEST          equ 0x100000      ; Segments must not cover the loader
+KERNEL_STAGING         equ 0x800000      ; ...nor the file copy above them
+KERNEL_PACKED          equ 0xC00000      ; Packed file, above the largest ELF
+
+; Packed kernel header: magic, unpacked size, packed size
+PACK_MAGIC             equ 0x4B345A4C    ; "LZ4K"
+PACK_HEADER_SIZE       equ 12
+
+BOUNCE_SEGMENT         equ 0x1000        ; Linear 0x10000, clear of any
+BOUNCE_ADDR            equ 0x10000       ; 64 KB DMA boundary
+BOUNCE_SECTORS         equ 127           ; Most every EDD BIOS accepts
+
+READ_RETRIES           equ 3
+
+ELF_MAGIC              equ 0x464C457F
+ELF_EM_386             equ 3
+ELF_PT_LOAD            equ 1
+
+stage2:
+    xor ax, ax
+    mov ds, ax
+    mov es, ax
+    mov [boot_drive], dl
+
+    ; Stamp only with a TSC; the boot sector left the stamps at 0
+    mov eax, 1
+    cpuid
+    test edx, CPUID_TSC
+    jz .stamped
+    mov byte [have_tsc], 1
+    rdtsc
+    mov [BOOT_INFO_ADDR + BOOT_INFO_TSC + 8], eax
+    mov [BOOT_INFO_ADDR + BOOT_INFO_TSC + 12], edx
+.stamped:
+
+    mov si, msg_loading
+    call print_string
+
+    call enable_a20
+    call probe_disk
+
+    ; The first sector holds the headers that give the file size
+    mov eax, KERNEL_LBA
+    mov cx, 1
+    call read_chunk
+    call enter_unreal
+    mov esi, BOUNCE_ADDR
+    cmp dword [esi], PACK_MAGIC
+    je .packed
+    call elf_file_sectors
+    mov dword [load_dest], KERNEL_STAGING
+    jmp .stage
+.packed:
+    call packed_file_sectors
+    mov dword [load_dest], KERNEL_PACKED
+
+    ; Stage the file
+.stage:
+    mov dword [load_lba], KERNEL_LBA
+.load:
+    mov ecx, [load_left]
+    test ecx, ecx
+    jz .loaded
+    cmp ecx, BOUNCE_SECTORS
+    jbe .count
+    mov ecx, BOUNCE_SECTORS
+.count:
+    mov eax, [load_lba]
+    call read_chunk
+    movzx ecx, cx
+    add [load_lba], ecx
+    sub [load_left], ecx
+
+    call enter_unreal
+    mov esi, BOUNCE_ADDR
+    mov edi, [load_dest]
+    shl ecx, 7                          ; Sectors to dwords
+    cld
+    a32 rep movsd
+    mov [load_dest], edi
+    jmp .load
+
+.loaded:
+    cmp byte [have_tsc], 0
+    je .read_stamped
+    rdtsc
+    mov [BOOT_INFO_ADDR + BOOT_INFO_TSC + 16], eax
+    mov [BOOT_INFO_ADDR + BOOT_INFO_TSC + 20], edx
+.read_stamped:
+
+    mov si, msg_success
+    call print_string
+
+    cli
+    lgdt [gdt_descriptor]
+
+    mov eax, cr0
+    or eax, 1
+    mov cr0, eax
+
+    jmp 0x08:protected_mode
+
+; Open the A20 gate: BIOS first, the fast A20 port if that did not work
+enable_a20:
+    mov ax, 0x2401
+    int 0x15
+    in al, 0x92
+    test al, 2
+    jnz .done
+    or al, 2
+    and al, 0xFE                        ; Bit 0 resets the machine
+    out 0x92, al
+.done:
+    ret
+
+; Use INT 13h extensions if the drive has them, else look up its geometry
+probe_disk:
+    mov ah, 0x41
+    mov bx, 0x55AA
+    mov dl, [boot_drive]
+    int 0x13
+    jc .chs
+    cmp bx, 0xAA55
+    jne .chs
+    test cx, 1                          ; Packet (AH=42h) access supported
+    jz .chs
+    mov byte [use_lba], 1
+    ret
+.chs:
+    mov ah, 0x08
+    mov dl, [boot_drive]
+    xor di, di
+    int 0x13
+    jc disk_error
+    xor ax, ax
+    mov es, ax                          ; AH=08h may change ES
+    and cl, 0x3F
+    mov [sectors_per_track], cl
+    movzx ax, dh
+    inc ax
+    mov [heads], ax
+    ret
+
+; Read CX sectors starting at LBA EAX into the bounce buffer. Returns the
+; count read in CX, which CHS reads cut short at the end of a track.
+read_chunk:
+    mov [chunk_lba], eax
+    mov [chunk_count], cx
+    mov byte [retries], READ_RETRIES
+.try:
+    cmp byte [use_lba], 0
+    je .chs
+
+    mov ax, [chunk_count]
+    mov [dap_count], ax
+    mov eax, [chunk_lba]
+    mov [dap_lba], eax
+    mov si, dap
+    mov ah, 0x42
+    mov dl, [boot_drive]
+    int 0x13
+    jc .retry
+    mov cx, [chunk_count]
+    ret
+
+.chs:
+    mov eax, [chunk_lba]
+    xor edx, edx
+    movzx ebx, byte [sectors_per_track]
+    div ebx                             ; EAX track, EDX sector - 1
+    mov cx, bx
+    sub cx, dx
+    cmp cx, [chunk_count]
+    jae .in_track
+    mov [chunk_count], cx
+.in_track:
+    inc dx
+    mov [chs_sector], dl
+    xor edx, edx
+    movzx ebx, word [heads]
+    div ebx                             ; EAX cylinder, EDX head
+    mov dh, dl
+    mov ch, al
+    mov cl, ah
+    shl cl, 6
+    or cl, [chs_sector]
+    mov al, [chunk_count]
+    mov ah, 0x02
+    mov dl, [boot_drive]
+    mov bx, BOUNCE_SEGMENT
+    mov es, bx
+    xor bx, bx
+    int 0x13
+    mov bx, 0
+    mov es, bx
+    jc .retry
+    mov cx, [chunk_count]
+    ret
+
+.retry:
+    dec byte [retries]
+    jz disk_error
+    xor ah, ah
+    mov dl, [boot_drive]
+    int 0x13                            ; Reset the drive
+    jmp .try
+
+; Give DS and ES 4 GB limits and return to real mode. The limits stay
+; cached until the next protected-mode segment load, which a BIOS call
+; may do, so the loader comes back here after each one.
+enter_unreal:
+    cli
+    push ds
+    push es
+    lgdt [gdt_descriptor]
+    mov eax, cr0
+    or al, 1
+    mov cr0, eax
+    jmp $+2
+    mov bx, 0x10
+    mov ds, bx
+    mov es, bx
+    and al, 0xFE
+    mov cr0, eax
+    pop es
+    pop ds
+    sti
+    ret
+
+; Check the ELF header in the bounce buffer and set load_left to the
+; sectors up to the end of the last PT_LOAD segment's file data
+elf_file_sectors:
+    mov esi, BOUNCE_ADDR
+    cmp dword [esi], ELF_MAGIC
+    jne elf_error
+    cmp byte [esi + 4], 1               ; ELFCLASS32
+    jne elf_error
+    cmp word [esi + 18], ELF_EM_386
+    jne elf_error
+
+    ; The program headers must be in the sector just read
+    movzx ecx, word [esi + 44]          ; e_phnum
+    movzx edx, word [esi + 42]          ; e_phentsize
+    mov ebx, [esi + 28]                 ; e_phoff
+    mov eax, edx
+    imul eax, ecx
+    add eax, ebx
+    cmp eax, 512
+    ja elf_error
+    add ebx, esi
+
+    xor edi, edi
+.header:
+    test ecx, ecx
+    jz .done
+    cmp dword [ebx], ELF_PT_LOAD
+    jne .next
+    mov eax, [ebx + 12]                 ; p_paddr
+    cmp eax, KERNEL_LOWEST
+    jb elf_error
+    add eax, [ebx + 20]                 ; p_memsz
+    cmp eax, KERNEL_STAGING
+    ja elf_error
+    mov eax, [ebx + 4]                  ; p_offset
+    add eax, [ebx + 16]                 ; p_filesz
+    cmp eax, edi
+    jbe .next
+    mov edi, eax
+.next:
+    add ebx, edx
+    dec ecx
+    jmp .header
+.done:
+    test edi, edi
+    jz elf_error
+    add edi, 511
+    shr edi, 9
+    mov [load_left], edi
+    ret
+
+; Check the packed kernel header in the bounce buffer and set load_left
+; to the sectors holding the header and the LZ4 block
+packed_file_sectors:
+    mov esi, BOUNCE_ADDR
+    cmp dword [esi + 4], KERNEL_PACKED - KERNEL_STAGING
+    ja elf_error
+    mov eax, [esi + 8]
+    add eax, PACK_HEADER_SIZE + 511
+    shr eax, 9
+    mov [load_left], eax
+    mov byte [packed], 1
+    ret
+
+elf_error:
+    mov si, msg_elf_error
+    call print_string
+    jmp $
+
+disk_error:
+    mov si, msg_error
+    call print_string
+    jmp $
+
+print_string:
+    pusha
+.loop:
+    lodsb
+    or al, al
+    jz .done
+    mov ah, 0x0E
+    int 0x10
+    jmp .loop
+.done:
+    popa
+    ret
+
+boot_drive        db 0
+use_lba           db 0
+sectors_per_track db 0
+chs_sector        db 0
+retries           db 0
+packed            db 0
+have_tsc          db 0
+heads             dw 0
+chunk_count       dw 0
+chunk_lba         dd 0
+load_lba          dd 0
+load_left         dd 0
+load_dest         dd 0
+kernel_start      dd 0
+kernel_end        dd 0
+
+; INT 13h AH=42h disk address packet
+align 4
+dap:
+    db 0x10, 0
+dap_count:
+    dw 0
+    dw 0, BOUNCE_SEGMENT                ; Buffer offset, segment
+dap_lba:
+    dd 0, 0
+
+msg_loading db 'Loading kernel...', 13, 10, 0
+msg_success db 'Kernel loaded! Starting...', 13, 10, 0
+msg_error db 'DISK ERROR!', 13, 10, 0
+msg_elf_error db 'KERNEL ERROR! Not a loadable ELF file', 13, 10, 0
+
+gdt_start:
+    dd 0x0, 0x0
+    dw 0xFFFF, 0x0
+    db 0x0, 10011010b, 11001111b, 0x0
+    dw 0xFFFF, 0x0
+    db 0x0, 10010010b, 11001111b, 0x0
+gdt_end:
+
+gdt_descriptor:
+    dw gdt_end - gdt_start - 1
+    dd gdt_start
+
+BITS 32
+protected_mode:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+    mov esp, KERNEL_STACK
+    cld
+
+    ; Unpack the kernel file. A corrupt image stops here rather than
+    ; being jumped into.
+    cmp byte [packed], 0
+    je .unpacked
+    mov esi, KERNEL_PACKED + PACK_HEADER_SIZE
+    mov ecx, [KERNEL_PACKED + 8]
+    add ecx, esi
+    mov edi, KERNEL_STAGING
+    call lz4_decompress
+    sub edi, KERNEL_STAGING
+    cmp edi, [KERNEL_PACKED + 4]
+    jne halt
+    cmp dword [KERNEL_STAGING], ELF_MAGIC
+    jne halt
+.unpacked:
+
+    ; Copy each PT_LOAD segment to its physical address and clear the
+    ; part the file does not cover (.bss)
+    mov ebp, KERNEL_STAGING
+    mov ebx, [ebp + 28]
+    add ebx, ebp
+    movzx ecx, word [ebp + 44]
+    mov dword [kernel_start], 0xFFFFFFFF
+.segment:
+    test ecx, ecx
+    jz .enter
+    push ecx
+    cmp dword [ebx], ELF_PT_LOAD
+    jne .next
+
+    mov edi, [ebx + 12]
+    cmp edi, KERNEL_LOWEST
+    jb halt
+    mov eax, edi
+    add eax, [ebx + 20]
+    cmp eax, KERNEL_STAGING
+    ja halt
+    cmp edi, [kernel_start]
+    jae .copy
+    mov [kernel_start], edi
+.copy:
+    mov esi, [ebx + 4]
+    add esi, ebp
+    mov ecx, [ebx + 16]
+    mov edx, ecx
+    shr ecx, 2
+    rep movsd
+    mov ecx, edx
+    and ecx, 3
+    rep movsb
+
+    mov ecx, [ebx + 20]
+    sub ecx, [ebx + 16]
+    xor eax, eax
+    rep stosb
+
+    cmp edi, [kernel_end]
+    jbe .next
+    mov [kernel_end], edi
+.next:
+    pop ecx
+    movzx eax, word [ebp + 42]
+    add ebx, eax
+    dec ecx
+    jmp .segment
+
+.enter:
+    ; Boot info is complete
+    mov eax, [kernel_start]
+    mov [BOOT_INFO_ADDR + BOOT_INFO_KERNEL_START], eax
+    mov eax, [kernel_end]
+    mov [BOOT_INFO_ADDR + BOOT_INFO_KERNEL_END], eax
+    mov dword [BOOT_INFO_ADDR + BOOT_INFO_STACK], KERNEL_STACK
+    mov dword [BOOT_INFO_ADDR], BOOT_INFO_MAGIC
+
+    cmp byte [have_tsc], 0
+    je .unpack_stamped
+    rdtsc
+    mov [BOOT_INFO_ADDR + BOOT_INFO_TSC + 24], eax
+    mov [BOOT_INFO_ADDR + BOOT_INFO_TSC + 28], edx
+.unpack_stamped:
+
+    mov eax, [ebp + 24]                 ; e_entry
+    call eax
+
+halt:
+    cli
+    hlt
+    jmp halt
+
+; Decompress the LZ4 block from ESI to EDI, ECX = end of the block.
+; Sequences are a token (literal count, match length - 4), the literals,
+; then a 16-bit match offset back into the output; the last sequence has
+; literals only. Leaves EDI at the end of the output.
+lz4_decompress:
+.sequence:
+    movzx eax, byte [esi]
+    inc esi
+    mov ebx, eax
+    shr eax, 4
+    cmp eax, 15
+    jne .literals
+.literal_length:
+    movzx edx, byte [esi]
+    inc esi
+    add eax, edx
+    cmp edx, 255
+    je .literal_length
+.literals:
+    push ecx
+    mov ecx, eax
+    rep movsb
+    pop ecx
+    cmp esi, ecx
+    jae .done
+
+    movzx edx, word [esi]
+    add esi, 2
+    and ebx, 15
+    cmp ebx, 15
+    jne .match
+.match_length:
+    movzx eax, byte [esi]
+    inc esi
+    add ebx, eax
+    cmp eax, 255
+    je .match_length
+.match:
+    add ebx, 4
+    push esi
+    push ecx
+    mov esi, edi
+    sub esi, edx
+    mov ecx, ebx
+    rep movsb                           ; Bytewise, so overlaps repeat
+    pop ecx
+    pop esi
+    jmp .sequence
+.done:
+    ret
+
+times STAGE2_SECTORS*512-($-$$) db 0
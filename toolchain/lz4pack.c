@@ -0,0 +1,191 @@
+// Host tool: pack the kernel file as one LZ4 block for boot/stage2.asm.
+//
+//   lz4pack <input> <output>
+//
+// Output is a 12-byte header (magic "LZ4K", unpacked size, packed size,
+// little-endian) followed by the block. The block is decompressed again
+// and compared before anything is written, so a packer bug fails the
+// build instead of the boot.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PACK_MAGIC       0x4B345A4C      // "LZ4K"
+#define PACK_HEADER_SIZE 12
+
+#define MIN_MATCH        4
+#define MAX_OFFSET       65535
+#define LAST_LITERALS    5               // Block end rules of the format
+#define MATCH_LIMIT      12
+#define HASH_BITS        16
+
+static unsigned int read32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void write32(unsigned char* p, unsigned int value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static unsigned int hash(unsigned int sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Length field overflow: 255s then the remainder
+static unsigned char* put_length(unsigned char* out, unsigned int length) {
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = length;
+    return out;
+}
+
+// One sequence: literals [anchor, anchor + literals), then a match of
+// match_length at offset (match_length 0 for the final sequence)
+static unsigned char* put_sequence(unsigned char* out, const unsigned char* anchor,
+                                   unsigned int literals, unsigned int offset,
+                                   unsigned int match_length) {
+    unsigned char* token = out++;
+    unsigned int match_code = match_length ? match_length - MIN_MATCH : 0;
+
+    *token = (literals < 15 ? literals : 15) << 4;
+    if (literals >= 15) {
+        out = put_length(out, literals - 15);
+    }
+    memcpy(out, anchor, literals);
+    out += literals;
+
+    if (match_length) {
+        *out++ = offset;
+        *out++ = offset >> 8;
+        *token |= match_code < 15 ? match_code : 15;
+        if (match_code >= 15) {
+            out = put_length(out, match_code - 15);
+        }
+    }
+    return out;
+}
+
+// Greedy compressor with a single-entry hash table; returns the size
+static size_t compress(const unsigned char* in, size_t size, unsigned char* out) {
+    static unsigned int table[1 << HASH_BITS];   // Position + 1, 0 = empty
+    unsigned char* start = out;
+    size_t anchor = 0;
+    size_t ip = 0;
+
+    memset(table, 0, sizeof(table));
+    while (size > MATCH_LIMIT && ip < size - MATCH_LIMIT) {
+        unsigned int sequence = read32(in + ip);
+        unsigned int h = hash(sequence);
+        size_t ref = table[h];
+        table[h] = ip + 1;
+
+        if (!ref || ip - (ref - 1) > MAX_OFFSET || read32(in + ref - 1) != sequence) {
+            ip++;
+            continue;
+        }
+        ref--;
+
+        size_t length = MIN_MATCH;
+        while (ip + length < size - LAST_LITERALS && in[ref + length] == in[ip + length]) {
+            length++;
+        }
+        out = put_sequence(out, in + anchor, ip - anchor, ip - ref, length);
+        ip += length;
+        anchor = ip;
+    }
+    out = put_sequence(out, in + anchor, size - anchor, 0, 0);
+    return out - start;
+}
+
+// Reference decompressor, the same steps as lz4_decompress in stage2.asm
+static size_t decompress(const unsigned char* in, size_t size, unsigned char* out) {
+    const unsigned char* end = in + size;
+    unsigned char* start = out;
+
+    while (1) {
+        unsigned int token = *in++;
+        unsigned int literals = token >> 4;
+        if (literals == 15) {
+            unsigned int extra;
+            do {
+                extra = *in++;
+                literals += extra;
+            } while (extra == 255);
+        }
+        memcpy(out, in, literals);
+        out += literals;
+        in += literals;
+        if (in >= end) {
+            break;
+        }
+
+        unsigned int offset = in[0] | (in[1] << 8);
+        unsigned int length = token & 15;
+        in += 2;
+        if (length == 15) {
+            unsigned int extra;
+            do {
+                extra = *in++;
+                length += extra;
+            } while (extra == 255);
+        }
+        length += MIN_MATCH;
+        for (unsigned int i = 0; i < length; i++, out++) {
+            *out = *(out - offset);
+        }
+    }
+    return out - start;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <input> <output>\n", argv[0]);
+        return 1;
+    }
+
+    FILE* file = fopen(argv[1], "rb");
+    if (!file) {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    // Worst case: every byte a literal, plus the length bytes
+    size_t bound = size + size / 255 + 16;
+    unsigned char* in = malloc(size + 1);
+    unsigned char* packed = malloc(PACK_HEADER_SIZE + bound);
+    unsigned char* check = malloc(size + 1);
+    if (!in || !packed || !check || fread(in, 1, size, file) != (size_t)size) {
+        fprintf(stderr, "%s: read failed\n", argv[1]);
+        return 1;
+    }
+    fclose(file);
+
+    size_t packed_size = compress(in, size, packed + PACK_HEADER_SIZE);
+    if (decompress(packed + PACK_HEADER_SIZE, packed_size, check) != (size_t)size ||
+        memcmp(in, check, size) != 0) {
+        fprintf(stderr, "%s: packed data does not round-trip\n", argv[1]);
+        return 1;
+    }
+    write32(packed, PACK_MAGIC);
+    write32(packed + 4, size);
+    write32(packed + 8, packed_size);
+
+    file = fopen(argv[2], "wb");
+    if (!file || fwrite(packed, 1, PACK_HEADER_SIZE + packed_size, file) != PACK_HEADER_SIZE + packed_size) {
+        perror(argv[2]);
+        return 1;
+    }
+    fclose(file);
+
+    printf("%s: %ld -> %zu bytes\n", argv[2], size, PACK_HEADER_SIZE + packed_size);
+    return 0;
+}
@@ -5,4 +5,10 @@ void shell_init();
 void shell_run();
 void shell_handle_key(char c);
 
+// Graphical shell (terminal_t from terminal.h)
+struct terminal;
+void shell_init_graphical(struct terminal* term);
+void shell_run_graphical(struct terminal* term);
+void shell_handle_key_graphical(struct terminal* term, char c);
+
 #endif
@@ -1,6 +1,17 @@
 #include "../../Lib/include/terminal.h"
 #include "../../Lib/include/keyboard.h"
+#include "../../Lib/include/serial.h"
+#include "../../Lib/include/softirq.h"
 #include "../../Lib/include/graphics.h"
+#include "../../Lib/include/heap.h"
+#include "../../Lib/include/pmm.h"
+#include "../../Lib/include/timer.h"
+#include "../../Lib/include/thread.h"
+#include "../../Lib/include/smp.h"
+#include "../../Lib/include/irqstat.h"
+#include "../../Lib/include/cpu.h"
+#include "../../Lib/include/boottime.h"
+#include "../../Lib/include/bench.h"
 
 #define MAX_COMMAND_LENGTH 256
 
@@ -8,6 +19,9 @@
 static char command_buffer[MAX_COMMAND_LENGTH];
 static int cmd_index = 0;
 
+// Scratch memory for the running command, released when it returns
+static arena_t command_arena;
+
 // String utilities (same as before)
 int strcmp(const char* s1, const char* s2) {
     while (*s1 && (*s1 == *s2)) {
@@ -76,6 +90,396 @@ void itoa(int num, char* str) {
     }
 }
 
+// Append a string to a line buffer, returning the new end
+static char* append(char* out, const char* str) {
+    while (*str) {
+        *out++ = *str++;
+    }
+    *out = '\0';
+    return out;
+}
+
+// Append a number right-aligned in a field of width characters
+static char* append_number(char* out, int num, int width) {
+    char digits[12];
+    itoa(num, digits);
+    for (int pad = width - strlen(digits); pad > 0; pad--) {
+        *out++ = ' ';
+    }
+    return append(out, digits);
+}
+
+// Append a number as 8 hex digits
+static char* append_hex(char* out, unsigned int num) {
+    static const char hex[] = "0123456789abcdef";
+    for (int shift = 28; shift >= 0; shift -= 4) {
+        *out++ = hex[(num >> shift) & 0xF];
+    }
+    *out = '\0';
+    return out;
+}
+
+// Show frame allocator and heap statistics
+static void shell_mem(terminal_t* term) {
+    pmm_stats_t frames;
+    heap_large_stats_t large;
+    char* line = arena_alloc(&command_arena, 128);
+    char* end;
+    
+    if (!line) {
+        terminal_println(term, "Out of memory");
+        return;
+    }
+    
+    pmm_get_stats(&frames);
+    end = append(line, "Frames: ");
+    end = append_number(end, frames.total, 0);
+    end = append(end, " total, ");
+    end = append_number(end, frames.free, 0);
+    end = append(end, " free (");
+    end = append_number(end, frames.free * (FRAME_SIZE / 1024), 0);
+    append(end, " KB)");
+    terminal_println(term, line);
+    
+    // Fragmentation: slots in the cache's slabs not holding an object
+    terminal_println(term, "  size    live   slabs  frag%    allocs     frees");
+    for (int i = 0; i < HEAP_CACHE_COUNT; i++) {
+        heap_cache_stats_t cache;
+        heap_get_cache_stats(i, &cache);
+        int frag = cache.capacity ? (cache.capacity - cache.live) * 100 / cache.capacity : 0;
+        
+        end = append_number(line, cache.object_size, 6);
+        end = append_number(end, cache.live, 8);
+        end = append_number(end, cache.slabs, 8);
+        end = append_number(end, frag, 7);
+        end = append_number(end, cache.allocs, 10);
+        append_number(end, cache.frees, 10);
+        terminal_println(term, line);
+    }
+    
+    heap_get_large_stats(&large);
+    end = append(line, " large");
+    end = append_number(end, large.live, 8);
+    end = append_number(end, large.frames, 8);
+    end = append(end, "      -");
+    end = append_number(end, large.allocs, 10);
+    append_number(end, large.frees, 10);
+    terminal_println(term, line);
+}
+
+// List kernel threads
+static void shell_ps(terminal_t* term) {
+    static const char* states[] = {"ready", "run", "block", "dead"};
+    thread_info_t* threads = arena_alloc(&command_arena, 16 * sizeof(thread_info_t));
+    char* line = arena_alloc(&command_arena, 128);
+    
+    if (!threads || !line) {
+        terminal_println(term, "Out of memory");
+        return;
+    }
+    
+    int count = thread_list(threads, 16);
+    terminal_println(term, "  id  pri  state      ms  name");
+    for (int i = 0; i < count; i++) {
+        char* end = append_number(line, threads[i].id, 4);
+        end = append_number(end, threads[i].priority, 5);
+        end = append(end, "  ");
+        end = append(end, states[threads[i].state]);
+        for (int pad = 5 - strlen(states[threads[i].state]); pad > 0; pad--) {
+            *end++ = ' ';
+        }
+        end = append_number(end, threads[i].run_ticks * 1000 / timer_hz(), 8);
+        end = append(end, "  ");
+        append(end, threads[i].name);
+        terminal_println(term, line);
+    }
+}
+
+// List online CPUs
+static void shell_cpus(terminal_t* term) {
+    char* line = arena_alloc(&command_arena, 64);
+    
+    if (!line) {
+        terminal_println(term, "Out of memory");
+        return;
+    }
+    
+    terminal_println(term, " cpu  apic   parts");
+    for (int i = 0; i < smp_cpu_count(); i++) {
+        cpu_t* cpu = smp_cpu(i);
+        char* end = append_number(line, cpu->index, 4);
+        end = append_number(end, cpu->apic_id, 6);
+        append_number(end, cpu->work_runs, 8);
+        terminal_println(term, line);
+    }
+}
+
+// Parse a decimal number (-1 if str is not one)
+static int parse_number(const char* str) {
+    int value = 0;
+    if (!*str) {
+        return -1;
+    }
+    while (*str) {
+        if (*str < '0' || *str > '9') {
+            return -1;
+        }
+        value = value * 10 + (*str++ - '0');
+    }
+    return value;
+}
+
+// Interrupt path costs: "irqstat" lists every vector taken, "irqstat N"
+// shows vector N's histogram and "irqstat reset" clears the counters
+static void shell_irqstat(terminal_t* term, const char* args) {
+    irqstat_t stats;
+    irqstat_totals_t totals;
+    char* line = arena_alloc(&command_arena, 128);
+    char* end;
+    
+    if (!line) {
+        terminal_println(term, "Out of memory");
+        return;
+    }
+    
+    if (strcmp(args, "reset") == 0) {
+        irqstat_reset();
+        terminal_println(term, "Interrupt statistics cleared");
+        return;
+    }
+    
+    if (*args) {
+        int vector = parse_number(args);
+        if (vector < 0 || vector >= IRQSTAT_VECTORS) {
+            terminal_println(term, "Usage: irqstat [vector|reset]");
+            return;
+        }
+        irqstat_get(vector, &stats);
+        terminal_println(term, "   cycles >=       count");
+        for (int i = 0; i < IRQSTAT_BUCKETS; i++) {
+            if (stats.histogram[i]) {
+                end = append_number(line, 1 << i, 12);
+                append_number(end, stats.histogram[i], 12);
+                terminal_println(term, line);
+            }
+        }
+        return;
+    }
+    
+    end = append(line, "Cycles at ");
+    end = append_number(end, div64_32(timer_tsc_hz(), 1000000), 0);
+    append(end, " MHz");
+    terminal_println(term, line);
+    terminal_println(term, " vec     count       min       avg       max");
+    for (int vector = 0; vector < IRQSTAT_VECTORS; vector++) {
+        irqstat_get(vector, &stats);
+        if (!stats.count) {
+            continue;
+        }
+        end = append_number(line, vector, 4);
+        end = append_number(end, stats.count, 10);
+        end = append_number(end, stats.min_cycles, 10);
+        end = append_number(end, stats.avg_cycles, 10);
+        append_number(end, stats.max_cycles, 10);
+        terminal_println(term, line);
+    }
+    
+    irqstat_get_totals(&totals);
+    end = append(line, "Nested ");
+    end = append_number(end, totals.nested, 0);
+    end = append(end, ", spurious IRQ7 ");
+    end = append_number(end, totals.spurious_pic7, 0);
+    end = append(end, ", IRQ15 ");
+    end = append_number(end, totals.spurious_pic15, 0);
+    end = append(end, ", APIC ");
+    append_number(end, totals.spurious_lapic, 0);
+    terminal_println(term, line);
+}
+
+// Deferred interrupt work: every softirq raised so far, then the
+// counters of the two input paths that feed it
+static void shell_softirqs(terminal_t* term) {
+    softirq_stats_t stats;
+    keyboard_stats_t keyboard;
+    serial_stats_t serial;
+    char* line = arena_alloc(&command_arena, 128);
+    char* end;
+    
+    if (!line) {
+        terminal_println(term, "Out of memory");
+        return;
+    }
+    
+    terminal_println(term, " nr    raised      runs  max delay us");
+    for (int nr = 0; nr < SOFTIRQ_COUNT; nr++) {
+        softirq_get_stats(nr, &stats);
+        if (!stats.raised) {
+            continue;
+        }
+        end = append_number(line, nr, 3);
+        end = append_number(end, stats.raised, 10);
+        end = append_number(end, stats.runs, 10);
+        append_number(end, div64_32(stats.max_delay_ns, 1000), 14);
+        terminal_println(term, line);
+    }
+    
+    keyboard_get_stats(&keyboard);
+    end = append(line, "Keyboard: ");
+    end = append_number(end, keyboard.events, 0);
+    end = append(end, " events, ");
+    end = append_number(end, keyboard.dropped, 0);
+    end = append(end, " dropped, ");
+    end = append_number(end, keyboard.raw_dropped, 0);
+    append(end, " lost before translation");
+    terminal_println(term, line);
+    
+    if (!serial_present()) {
+        terminal_println(term, "Serial: no COM1");
+        return;
+    }
+    serial_get_stats(&serial);
+    end = append(line, "Serial: sent ");
+    end = append_number(end, serial.tx_bytes, 0);
+    end = append(end, " (");
+    end = append_number(end, serial.tx_dropped, 0);
+    end = append(end, " dropped), received ");
+    end = append_number(end, serial.rx_bytes, 0);
+    end = append(end, " (");
+    end = append_number(end, serial.rx_dropped, 0);
+    append(end, " dropped)");
+    terminal_println(term, line);
+}
+
+// Boot phase durations: "boottime" prints a table, "boottime json" the
+// same as a single JSON object on one line for scripts
+static void shell_boottime(terminal_t* term, const char* args) {
+    boottime_mark_t* marks = arena_alloc(&command_arena, BOOTTIME_MAX_MARKS * sizeof(boottime_mark_t));
+    int json = strcmp(args, "json") == 0;
+    char* end;
+    
+    if (!marks) {
+        terminal_println(term, "Out of memory");
+        return;
+    }
+    if (*args && !json) {
+        terminal_println(term, "Usage: boottime [json]");
+        return;
+    }
+    
+    int count = boottime_marks(marks, BOOTTIME_MAX_MARKS);
+    unsigned long long previous = 0;
+    
+    // The JSON line holds every mark: its name plus at most 32 characters
+    // of quoting and number, and 64 for the fields around the list
+    int size = 64;
+    for (int i = 0; i < count; i++) {
+        size += strlen(marks[i].name) + 32;
+    }
+    char* line = arena_alloc(&command_arena, size);
+    if (!line) {
+        terminal_println(term, "Out of memory");
+        return;
+    }
+    
+    if (json) {
+        end = append(line, "{\"tsc_mhz\":");
+        end = append_number(end, div64_32(timer_tsc_hz(), 1000000), 0);
+        end = append(end, ",\"phases\":[");
+    } else {
+        terminal_println(term, "phase                 us    total us");
+    }
+    for (int i = 0; i < count; i++) {
+        int phase_us = div64_32(timer_cycles_to_ns(marks[i].tsc - previous), 1000);
+        int total_us = div64_32(timer_cycles_to_ns(marks[i].tsc), 1000);
+        previous = marks[i].tsc;
+        
+        if (json) {
+            end = append(end, i ? ",{\"name\":\"" : "{\"name\":\"");
+            end = append(end, marks[i].name);
+            end = append(end, "\",\"us\":");
+            end = append_number(end, phase_us, 0);
+            end = append(end, "}");
+            continue;
+        }
+        end = append(line, marks[i].name);
+        for (int pad = 16 - strlen(marks[i].name); pad > 0; pad--) {
+            *end++ = ' ';
+        }
+        end = append_number(end, phase_us, 8);
+        append_number(end, total_us, 12);
+        terminal_println(term, line);
+    }
+    
+    if (json) {
+        end = append(end, "],\"total_us\":");
+        end = append_number(end, div64_32(timer_cycles_to_ns(previous), 1000), 0);
+        append(end, "}");
+        terminal_println(term, line);
+    }
+}
+
+// Run the kernel microbenchmarks, one JSON object per line (the format
+// Scripts/bench.sh reads). "bench exit" then leaves QEMU through
+// isa-debug-exit.
+static void shell_bench(terminal_t* term, const char* args) {
+    bench_result_t result;
+    char* line = arena_alloc(&command_arena, 160);
+    int do_exit = strcmp(args, "exit") == 0;
+    
+    if (!line) {
+        terminal_println(term, "Out of memory");
+        return;
+    }
+    if (*args && !do_exit) {
+        terminal_println(term, "Usage: bench [exit]");
+        return;
+    }
+    
+    for (int i = 0; i < bench_count(); i++) {
+        if (!bench_run(i, &result)) {
+            terminal_println(term, "No TSC; cannot time benchmarks");
+            if (do_exit) {
+                bench_exit(1);
+            }
+            return;
+        }
+        
+        char* end = append(line, "{\"bench\":\"");
+        end = append(end, result.name);
+        end = append(end, "\",\"iterations\":");
+        end = append_number(end, result.iterations, 0);
+        end = append(end, ",\"min_cycles\":");
+        end = append_number(end, result.min_cycles, 0);
+        end = append(end, ",\"avg_cycles\":");
+        end = append_number(end, result.avg_cycles, 0);
+        if (result.hashed) {
+            end = append(end, ",\"hash\":\"");
+            end = append_hex(end, result.hash);
+            end = append(end, "\"");
+        }
+        append(end, "}");
+        terminal_println(term, line);
+        terminal_render(term);
+        graphics_present();
+    }
+    
+    char* end = append(line, "{\"bench_done\":");
+    end = append_number(end, bench_count(), 0);
+    end = append(end, ",\"tsc_mhz\":");
+    end = append_number(end, div64_32(timer_tsc_hz(), 1000000), 0);
+    append(end, "}");
+    terminal_println(term, line);
+    
+    // Put back what the benchmarks drew over
+    graphics_restore_background(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    terminal_invalidate(term, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    
+    if (do_exit) {
+        bench_exit(0);
+        terminal_println(term, "No isa-debug-exit device; staying up");
+    }
+}
+
 // Print prompt
 void shell_prompt(terminal_t* term) {
     color_t green = {0, 255, 0, 255};
@@ -91,7 +495,6 @@ void shell_prompt(terminal_t* term) {
     terminal_print(term, "~");
     terminal_set_color(term, white, transparent);
     terminal_print(term, "$ ");
-    terminal_render(term);
 }
 
 // Execute command
@@ -115,21 +518,25 @@ void shell_execute(terminal_t* term, const char* cmd) {
         terminal_set_color(term, cyan, transparent);
         terminal_println(term, "Available commands:");
         terminal_set_color(term, white, transparent);
-        terminal_println(term, "  help    - Show this help");
-        terminal_println(term, "  clear   - Clear screen");
-        terminal_println(term, "  about   - About this OS");
-        terminal_println(term, "  echo    - Echo text");
-        terminal_println(term, "  test    - Graphics test");
-        terminal_println(term, "  reboot  - Reboot system");
-        terminal_render(term);
+        terminal_println(term, "  help     - Show this help");
+        terminal_println(term, "  clear    - Clear screen");
+        terminal_println(term, "  about    - About this OS");
+        terminal_println(term, "  echo     - Echo text");
+        terminal_println(term, "  test     - Graphics test");
+        terminal_println(term, "  mem      - Memory statistics");
+        terminal_println(term, "  ps       - List threads");
+        terminal_println(term, "  cpus     - List processors");
+        terminal_println(term, "  irqstat  - Interrupt costs");
+        terminal_println(term, "  softirqs - Deferred interrupt work");
+        terminal_println(term, "  boottime - Boot phase times");
+        terminal_println(term, "  bench    - Microbenchmarks");
+        terminal_println(term, "  reboot   - Reboot system");
         return;
     }
     
     // CLEAR
     if (strcmp(cmd, "clear") == 0) {
         terminal_clear(term);
-        graphics_load_wallpaper();
-        terminal_render(term);
         return;
     }
     
@@ -145,7 +552,60 @@ void shell_execute(terminal_t* term, const char* cmd) {
         terminal_println(term, "  - Gradient wallpaper");
         terminal_println(term, "  - Software font rendering");
         terminal_println(term, "  - Alpha blending");
-        terminal_render(term);
+        return;
+    }
+    
+    // MEM
+    if (strcmp(cmd, "mem") == 0) {
+        shell_mem(term);
+        return;
+    }
+    
+    // PS
+    if (strcmp(cmd, "ps") == 0) {
+        shell_ps(term);
+        return;
+    }
+    
+    // CPUS
+    if (strcmp(cmd, "cpus") == 0) {
+        shell_cpus(term);
+        return;
+    }
+    
+    // IRQSTAT
+    if (strcmp(cmd, "irqstat") == 0) {
+        shell_irqstat(term, "");
+        return;
+    }
+    if (starts_with(cmd, "irqstat ")) {
+        shell_irqstat(term, cmd + 8);
+        return;
+    }
+    
+    // SOFTIRQS
+    if (strcmp(cmd, "softirqs") == 0) {
+        shell_softirqs(term);
+        return;
+    }
+    
+    // BOOTTIME
+    if (strcmp(cmd, "boottime") == 0) {
+        shell_boottime(term, "");
+        return;
+    }
+    if (starts_with(cmd, "boottime ")) {
+        shell_boottime(term, cmd + 9);
+        return;
+    }
+    
+    // BENCH
+    if (strcmp(cmd, "bench") == 0) {
+        shell_bench(term, "");
+        return;
+    }
+    if (starts_with(cmd, "bench ")) {
+        shell_bench(term, cmd + 6);
         return;
     }
     
@@ -154,7 +614,6 @@ void shell_execute(terminal_t* term, const char* cmd) {
         terminal_set_color(term, yellow, transparent);
         terminal_println(term, cmd + 5);
         terminal_set_color(term, white, transparent);
-        terminal_render(term);
         return;
     }
     
@@ -163,9 +622,6 @@ void shell_execute(terminal_t* term, const char* cmd) {
         terminal_println(term, "Running graphics test...");
         terminal_render(term);
         
-        // Draw some shapes on the wallpaper
-        graphics_load_wallpaper();
-        
         // Draw rectangles
         graphics_fill_rect(50, 50, 100, 100, (color_t){0, 0, 255, 200});
         graphics_fill_rect(170, 50, 100, 100, (color_t){0, 255, 0, 200});
@@ -174,18 +630,18 @@ void shell_execute(terminal_t* term, const char* cmd) {
         // Draw some lines
         graphics_draw_line(50, 200, 400, 350, COLOR_YELLOW);
         graphics_draw_line(400, 200, 50, 350, COLOR_CYAN);
+        graphics_present();
         
-        // Small delay
-        for (volatile int i = 0; i < 30000000; i++);
+        // Leave the shapes up for a second
+        sleep_ms(1000);
         
-        // Redraw wallpaper and terminal
-        graphics_load_wallpaper();
-        terminal_render(term);
+        // Erase the test shapes and repaint the terminal cells under them
+        graphics_restore_background(50, 50, 351, 301);
+        terminal_invalidate(term, 50, 50, 351, 301);
         
         terminal_set_color(term, green, transparent);
         terminal_println(term, "Test complete!");
         terminal_set_color(term, white, transparent);
-        terminal_render(term);
         return;
     }
     
@@ -194,8 +650,9 @@ void shell_execute(terminal_t* term, const char* cmd) {
         terminal_set_color(term, yellow, transparent);
         terminal_println(term, "Rebooting...");
         terminal_render(term);
+        graphics_present();
         
-        for (volatile int i = 0; i < 10000000; i++);
+        sleep_ms(500);
         
         unsigned char temp;
         __asm__ __volatile__("inb %1, %0" : "=a"(temp) : "Nd"((unsigned short)0x64));
@@ -215,12 +672,12 @@ void shell_execute(terminal_t* term, const char* cmd) {
     terminal_set_color(term, gray, transparent);
     terminal_println(term, "Type 'help' for commands");
     terminal_set_color(term, white, transparent);
-    terminal_render(term);
 }
 
 // Initialize shell
 void shell_init_graphical(terminal_t* term) {
     cmd_index = 0;
+    arena_init(&command_arena);
     
     color_t cyan = {255, 255, 0, 255};
     color_t gray = {128, 128, 128, 255};
@@ -234,19 +691,25 @@ void shell_init_graphical(terminal_t* term) {
     terminal_println(term, "Type 'help' for available commands.");
     terminal_set_color(term, white, transparent);
     terminal_println(term, "");
-    terminal_render(term);
     
     shell_prompt(term);
+    terminal_render(term);
+    graphics_present();
+    boottime_mark("prompt");
 }
 
 // Handle key input
 void shell_handle_key_graphical(terminal_t* term, char c) {
-    if (c == '\n') {
+    if ((unsigned char)c == KEY_PGUP) {
+        terminal_scroll_view(term, term->rows / 2);
+    } else if ((unsigned char)c == KEY_PGDN) {
+        terminal_scroll_view(term, -(term->rows / 2));
+    } else if (c == '\n') {
         terminal_putchar(term, '\n');
-        terminal_render(term);
         
         command_buffer[cmd_index] = '\0';
         shell_execute(term, command_buffer);
+        arena_release(&command_arena);
         cmd_index = 0;
         
         shell_prompt(term);
@@ -254,12 +717,11 @@ void shell_handle_key_graphical(terminal_t* term, char c) {
         if (cmd_index > 0) {
             cmd_index--;
             terminal_putchar(term, '\b');
-            terminal_render(term);
         }
-    } else if (cmd_index < MAX_COMMAND_LENGTH - 1) {
+    } else if (c >= 0x20 && c <= 0x7E && cmd_index < MAX_COMMAND_LENGTH - 1) {
+        // Printable only: arrows, control bytes and the like are ignored
         command_buffer[cmd_index++] = c;
         terminal_putchar(term, c);
-        terminal_render(term);
     }
 }
 
@@ -268,10 +730,25 @@ void shell_run_graphical(terminal_t* term) {
     shell_init_graphical(term);
     
     while (1) {
-        if (keyboard_available()) {
-            char c = keyboard_getchar();
-            shell_handle_key_graphical(term, c);
+        input_event_t events[32];
+        int count;
+        
+        // Blocks the shell thread until input arrives
+        keyboard_wait_event();
+        
+        // Apply everything that is pending (a burst of typing or a
+        // paste), then render once for the lot
+        while ((count = keyboard_read_events(events, 32)) > 0) {
+            for (int i = 0; i < count; i++) {
+                if (events[i].pressed && events[i].keycode) {
+                    shell_handle_key_graphical(term, events[i].keycode);
+                }
+            }
         }
-        __asm__ __volatile__("hlt");
+        
+        // Output only updates terminal cells; repaint what changed and
+        // update the framebuffer once per batch
+        terminal_render(term);
+        graphics_present();
     }
 }